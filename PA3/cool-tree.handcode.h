@@ -32,6 +32,7 @@ class Expression_class;
 typedef Expression_class *Expression;
 class Case_class;
 typedef Case_class *Case;
+class ast_writer;
 
 typedef list_node<Class_> Classes_class;
 typedef Classes_class *Classes;
@@ -45,62 +46,75 @@ typedef list_node<Case> Cases_class;
 typedef Cases_class *Cases;
 
 #define Program_EXTRAS                          \
-virtual void dump_with_types(ostream&, int) = 0; 
+virtual void dump_with_types(ostream&, int) = 0; \
+virtual void dump_binary(ast_writer&) = 0;       \
+void write_binary(FILE *);
 
 
 
 #define program_EXTRAS                          \
-void dump_with_types(ostream&, int);            
+void dump_with_types(ostream&, int);            \
+void dump_binary(ast_writer&);
 
 #define Class__EXTRAS                   \
 virtual Symbol get_filename() = 0;      \
-virtual void dump_with_types(ostream&,int) = 0; 
+virtual void dump_with_types(ostream&,int) = 0; \
+virtual void dump_binary(ast_writer&) = 0;
 
 
 #define class__EXTRAS                                 \
 Symbol get_filename() { return filename; }             \
-void dump_with_types(ostream&,int);                    
+void dump_with_types(ostream&,int);             \
+void dump_binary(ast_writer&);
 
 
 #define Feature_EXTRAS                                        \
-virtual void dump_with_types(ostream&,int) = 0; 
+virtual void dump_with_types(ostream&,int) = 0; \
+virtual void dump_binary(ast_writer&) = 0;
 
 
 #define Feature_SHARED_EXTRAS                                       \
-void dump_with_types(ostream&,int);    
+void dump_with_types(ostream&,int);             \
+void dump_binary(ast_writer&);
 
 
 
 
 
 #define Formal_EXTRAS                              \
-virtual void dump_with_types(ostream&,int) = 0;
+virtual void dump_with_types(ostream&,int) = 0; \
+virtual void dump_binary(ast_writer&) = 0;
 
 
 #define formal_EXTRAS                           \
-void dump_with_types(ostream&,int);
+void dump_with_types(ostream&,int);             \
+void dump_binary(ast_writer&);
 
 
 #define Case_EXTRAS                             \
-virtual void dump_with_types(ostream& ,int) = 0;
+virtual void dump_with_types(ostream& ,int) = 0; \
+virtual void dump_binary(ast_writer&) = 0;
 
 
 #define branch_EXTRAS                                   \
-void dump_with_types(ostream& ,int);
+void dump_with_types(ostream& ,int);            \
+void dump_binary(ast_writer&);
 
 
 #define Expression_EXTRAS                    \
 Symbol type;                                 \
 Symbol get_type() { return type; }           \
 Expression set_type(Symbol s) { type = s; return this; } \
-virtual void dump_with_types(ostream&,int) = 0;  \
+virtual void dump_with_types(ostream&,int) = 0; \
+virtual void dump_binary(ast_writer&) = 0;      \
 void dump_type(ostream&, int);               \
 Expression_class() { type = (Symbol) NULL; }
 
 
 
 #define Expression_SHARED_EXTRAS           \
-void dump_with_types(ostream&,int); 
+void dump_with_types(ostream&,int);             \
+void dump_binary(ast_writer&);
 
 
 #endif
@@ -8,27 +8,36 @@
   #include "cool-tree.h"
   #include "stringtab.h"
   #include "utilities.h"
+  #include "parse-context.h"
   
-  extern char *curr_filename;
   
-  
-  /* Locations */
-  #define YYLTYPE int              /* the type of locations */
-  #define cool_yylloc curr_lineno  /* use the curr_lineno from the lexer
-  for the location of tokens */
+  /* Locations are bison's own YYLTYPE; only first_line is used, and
+  each token's is the line number from the lexer.  Compiled as C++,
+  bison can grow its stack only with its own kinds of locations and
+  values.  The stack starts small and grows as needed, up to as deep
+  as pratt_parse nests (see parse-context.h). */
+  #define YYMAXDEPTH MAX_PARSE_DEPTH
     
-    extern int node_lineno;          /* set before constructing a tree node
+    extern __thread int node_lineno; /* set before constructing a tree node
     to whatever you want the line number
     for the tree node to be */
       
       
       #define YYLLOC_DEFAULT(Current, Rhs, N)         \
-      Current = Rhs[1];                             \
-      node_lineno = Current;
+      (Current) = (Rhs)[1];                         \
+      node_lineno = (Current).first_line;
+      
+      /* Every action starts with COUNT_RULE(n), to count the reduction
+      for parse_stats: n is the number of its rule in parse_rules (at the
+      end of this file), which is bison's own for it.  yychar is the
+      lookahead, if bison has read one it has not yet shifted. */
+      #define COUNT_RULE(Rule)                         \
+      if (ctx->stats != NULL)                       \
+        count_reduction(ctx, Rule, yychar != YYEMPTY);
     
     
     #define SET_NODELOC(Current)  \
-    node_lineno = Current;
+    node_lineno = Current.first_line;
     
     /* IMPORTANT NOTE ON LINE NUMBERS
     *********************************
@@ -74,7 +83,11 @@
     
     
     
-    void yyerror(char *s);        /*  defined below; called for each parse error */
+    /* The parser is pure: all of its state is in ctx (see parse-context.h).
+    yyerror and yylex are declared after the %union, as bison defines
+    YYLTYPE only after this prologue. */
+    static void count_reduction(parse_context *ctx, int rule, int lookahead);
+                                  /*  defined below; for parse_stats */
     extern int yylex();           /*  the entry point to the lexer  */
     
     /************************************************************************/
@@ -83,8 +96,18 @@
     Program ast_root;	      /* the result of the parse  */
     Classes parse_results;        /* for use in semantic analysis */
     int omerrs = 0;               /* number of errors in lexing and parsing */
+    YYSTYPE cool_yylval;          /* the value of the token cool_yylex returns */
+    int curr_lineno;              /* and its line number */
     %}
     
+    %define api.pure full
+    %parse-param {parse_context *ctx}
+    %lex-param {parse_context *ctx}
+    %initial-action {
+      if (ctx->stats != NULL)
+        ctx->stats->depth = 0;
+    }
+    
     /* A union of all the types that can be the result of parsing actions. */
     %union {
       Boolean boolean;
@@ -103,6 +126,13 @@
       char *error_msg;
     }
     
+    %code {
+    void yyerror(YYLTYPE *loc, parse_context *ctx, const char *s);
+                                  /*  defined below; called for each parse error */
+    static int yylex(YYSTYPE *lval, YYLTYPE *loc, parse_context *ctx);
+                                  /*  defined below; reads ctx's next token */
+    }
+    
     /* 
     Declare the terminals; a few have types for associated lexemes.
     The token ERROR is never used in the parser; thus, it is a parse
@@ -165,32 +195,32 @@
     %left     '.' 
     %%
     /* 
-    Save the root of the abstract syntax tree in a global variable.
+    Save the root of the abstract syntax tree in the parse context.
     */
-    program	: class_list	{ @$ = @1; ast_root = program($1); }
+    program	: class_list	{ COUNT_RULE(1); @$ = @1; ctx->program = program($1); }
     ;
     
     class_list
     : class			/* single class */
-    { @$ = @1;SET_NODELOC(@1);
+    { COUNT_RULE(2); @$ = @1;SET_NODELOC(@1);
       $$ = single_Classes($1);
-      parse_results = $$; }
+      ctx->classes = $$; }
     | class_list class	/* several classes */
-    { @$ = @1;SET_NODELOC(@1);
-      $$ = append_Classes($1,single_Classes($2)); 
-      parse_results = $$; }
+    { COUNT_RULE(3); @$ = @1;SET_NODELOC(@1);
+      $$ = extend_list($1, $2); 
+      ctx->classes = $$; }
     | error ';' class_list
-    { yyerrok; }
+    { COUNT_RULE(4); yyerrok; }
     ;
     
     /* If no parent is specified, the class inherits from the Object class. */
     class	: CLASS TYPEID '{' feature_list '}' ';'
-    { @$ = @1;SET_NODELOC(@1); 
+    { COUNT_RULE(5); @$ = @1;SET_NODELOC(@1); 
       $$ = class_($2,idtable.add_string("Object"),$4,
-     stringtable.add_string(curr_filename)); }
+     stringtable.add_string(ctx->filename)); }
     | CLASS TYPEID INHERITS TYPEID '{' feature_list '}' ';'
-    { @$ = @1;SET_NODELOC(@1); 
-      $$ = class_($2,$4,$6,stringtable.add_string(curr_filename)); }
+    { COUNT_RULE(6); @$ = @1;SET_NODELOC(@1); 
+      $$ = class_($2,$4,$6,stringtable.add_string(ctx->filename)); }
     ;
     
     /* Feature list may be empty, but no empty features in list. */
@@ -198,76 +228,76 @@
     {  $$ = nil_Features(); }
 
     feature_list :
-		{ $$ = nil_Features(); }
+		{ COUNT_RULE(7); $$ = nil_Features(); }
                  | feature 
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(8); @$ = @1;SET_NODELOC(@1);
                   $$ = single_Features($1); }
                  | feature_list feature 
-                { @$ = @1;SET_NODELOC(@1);
-                  $$ = append_Features($1, single_Features($2)); } 
+                { COUNT_RULE(9); @$ = @1;SET_NODELOC(@1);
+                  $$ = extend_list($1, $2); } 
                  | error ';' feature_list
-                { yyerrok; }
+                { COUNT_RULE(10); yyerrok; }
                  ;  
 
     feature      :  OBJECTID '(' formal_list ')' ':' TYPEID '{' expr '}' ';' 
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(11); @$ = @1;SET_NODELOC(@1);
                   $$ = method($1,$3,$6,$8); }
                  |  OBJECTID ':' TYPEID ';'
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(12); @$ = @1;SET_NODELOC(@1);
                   $$ = attr($1,$3,no_expr()); }
                  |  OBJECTID ':' TYPEID ASSIGN expr ';'
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(13); @$ = @1;SET_NODELOC(@1);
                   $$ = attr($1,$3,$5); }
                  ;
 
     formal_list  :
-                { $$ = nil_Formals(); }
+                { COUNT_RULE(14); $$ = nil_Formals(); }
                  | formal
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(15); @$ = @1;SET_NODELOC(@1);
                   $$ = single_Formals($1); }
                  | formal_list ',' formal
-                { @$ = @1;SET_NODELOC(@1);
-                  $$ = append_Formals($1, single_Formals($3)); }
+                { COUNT_RULE(16); @$ = @1;SET_NODELOC(@1);
+                  $$ = extend_list($1, $3); }
                  ;
 
     formal       : OBJECTID ':' TYPEID
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(17); @$ = @1;SET_NODELOC(@1);
                   $$ = formal($1,$3); }
                  ;
 
     case_branch  : OBJECTID ':' TYPEID DARROW expr ';'
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(18); @$ = @1;SET_NODELOC(@1);
                   $$ = branch($1,$3,$5); }
                  ;
 
     case_branches: case_branch 
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(19); @$ = @1;SET_NODELOC(@1);
                   $$ = single_Cases($1); }
                  | case_branches case_branch
-                { @$ = @1;SET_NODELOC(@1);
-                  $$ = append_Cases($1, single_Cases($2)); }
+                { COUNT_RULE(20); @$ = @1;SET_NODELOC(@1);
+                  $$ = extend_list($1, $2); }
                  ;
 
     /* block_exprs: [[expr;]]* */
     block_exprs  : expr ';'
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(21); @$ = @1;SET_NODELOC(@1);
                   $$ = single_Expressions($1); }
                  | block_exprs expr ';'
-                { @$ = @1;SET_NODELOC(@1);
-                  $$ = append_Expressions($1, single_Expressions($2)); }
+                { COUNT_RULE(22); @$ = @1;SET_NODELOC(@1);
+                  $$ = extend_list($1, $2); }
                  | error ';' block_exprs
-                { yyerrok; }
+                { COUNT_RULE(23); yyerrok; }
                  ;
 
     /* dispt_exprs: [expr [[, expr]]*] */
     dispt_exprs  :
-                { $$ = nil_Expressions(); }
+                { COUNT_RULE(24); $$ = nil_Expressions(); }
                  | expr
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(25); @$ = @1;SET_NODELOC(@1);
                   $$ = single_Expressions($1); }
                  | dispt_exprs ',' expr
-                { @$ = @1;SET_NODELOC(@1);
-                  $$ = append_Expressions($1, single_Expressions($3)); }
+                { COUNT_RULE(26); @$ = @1;SET_NODELOC(@1);
+                  $$ = extend_list($1, $3); }
                  ;
 /*
     expr_list    :
@@ -275,119 +305,294 @@
                  | expr
                 { $$ = single_Expressions($1); }
                  | expr_list expr
-                { $$ = append_Expressions($1, single_Expressions($2)); }
+                { $$ = extend_list($1, $2); }
                  ;
 */
     let_list     : OBJECTID ':' TYPEID IN expr
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(27); @$ = @1;SET_NODELOC(@1);
                   $$ = let($1,$3,no_expr(),$5); }
                  | OBJECTID ':' TYPEID ASSIGN expr IN expr
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(28); @$ = @1;SET_NODELOC(@1);
                   $$ = let($1,$3,$5,$7); }
                  | OBJECTID ':' TYPEID ',' let_list
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(29); @$ = @1;SET_NODELOC(@1);
                   $$ = let($1,$3,no_expr(),$5); }
                  | OBJECTID ':' TYPEID ASSIGN expr ',' let_list
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(30); @$ = @1;SET_NODELOC(@1);
                   $$ = let($1,$3,$5,$7); }
                  | error
-                { yyerrok; }
+                { COUNT_RULE(31); yyerrok; }
                  ;
 
     expr         : OBJECTID ASSIGN expr
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(32); @$ = @1;SET_NODELOC(@1);
                   $$ = assign($1,$3); }
                  | expr '.' OBJECTID '(' dispt_exprs ')'
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(33); @$ = @1;SET_NODELOC(@1);
                   $$ = dispatch($1,$3,$5); }
                  | expr '@' TYPEID '.' OBJECTID '(' dispt_exprs ')'
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(34); @$ = @1;SET_NODELOC(@1);
                   $$ = static_dispatch($1,$3,$5,$7); }
                  | OBJECTID '(' dispt_exprs ')'
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(35); @$ = @1;SET_NODELOC(@1);
                   $$ = dispatch(object(idtable.add_string("self")),$1,$3); } 
                  | IF expr THEN expr ELSE expr FI
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(36); @$ = @1;SET_NODELOC(@1);
                   $$ = cond($2,$4,$6); }
                  | WHILE expr LOOP expr POOL
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(37); @$ = @1;SET_NODELOC(@1);
                   $$ = loop($2,$4); }
                  | '{' block_exprs '}' 
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(38); @$ = @1;SET_NODELOC(@1);
                   $$ = block($2); }
                  | '{' error '}'
-                { yyerrok; }
+                { COUNT_RULE(39); yyerrok; }
                  | LET let_list 
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(40); @$ = @1;SET_NODELOC(@1);
                   $$ = $2; }
                  | CASE expr OF case_branches ESAC 
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(41); @$ = @1;SET_NODELOC(@1);
                   $$ = typcase($2,$4); } 
                  | NEW TYPEID
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(42); @$ = @1;SET_NODELOC(@1);
                   $$ = new_($2); }
                  | ISVOID expr
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(43); @$ = @1;SET_NODELOC(@1);
                   $$ = isvoid($2); }
                  | expr '+' expr
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(44); @$ = @1;SET_NODELOC(@1);
                   $$ = plus($1,$3); }
                  | expr '-' expr
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(45); @$ = @1;SET_NODELOC(@1);
                   $$ = sub($1,$3); }
                  | expr '*' expr
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(46); @$ = @1;SET_NODELOC(@1);
                   $$ = mul($1,$3); }
                  | expr '/' expr
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(47); @$ = @1;SET_NODELOC(@1);
                   $$ = divide($1,$3); }
                  | '~' expr
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(48); @$ = @1;SET_NODELOC(@1);
                   $$ = neg($2); }
                  | expr '<' expr
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(49); @$ = @1;SET_NODELOC(@1);
                   $$ = lt($1,$3); }
                  | expr LE expr
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(50); @$ = @1;SET_NODELOC(@1);
                   $$ = leq($1,$3); }
                  | expr '=' expr
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(51); @$ = @1;SET_NODELOC(@1);
                   $$ = eq($1,$3); }
                  | NOT expr      
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(52); @$ = @1;SET_NODELOC(@1);
                   $$ = comp($2); }
                  | '(' expr ')'
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(53); @$ = @1;SET_NODELOC(@1);
                   $$ = $2; }
                  | OBJECTID
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(54); @$ = @1;SET_NODELOC(@1);
                   $$ = object($1); }
                  | INT_CONST
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(55); @$ = @1;SET_NODELOC(@1);
                   $$ = int_const($1); }
                  | STR_CONST
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(56); @$ = @1;SET_NODELOC(@1);
                   $$ = string_const($1); }
                  | BOOL_CONST
-                { @$ = @1;SET_NODELOC(@1);
+                { COUNT_RULE(57); @$ = @1;SET_NODELOC(@1);
                   $$ = bool_const($1); }
                  ;
  
     /* end of grammar */
     %%
     
-    /* This function is called automatically when Bison detects a parse error. */
-    void yyerror(char *s)
+    /* Read the next token for the parser.  It is kept in ctx, with its
+    line number, for error messages; after too many errors, the input
+    ends there. */
+    static int yylex(YYSTYPE *lval, YYLTYPE *loc, parse_context *ctx)
+    {
+      if (ctx->errors > MAX_PARSE_ERRORS)
+        return 0;
+      ctx->token = ctx->read_token(ctx, &ctx->lval, &ctx->lineno);
+      if (ctx->stats != NULL) {
+        ctx->stats->tokens++;
+        ctx->stats->depth++;
+      }
+      *lval = ctx->lval;
+      loc->first_line = loc->last_line = ctx->lineno;
+      return ctx->token;
+    }
+    
+    /* The rules of the grammar, in its order, which is the order bison
+    numbers them in (see cool.output): each with the number of symbols
+    on its right side. */
+    static struct parse_rule {
+      char *lhs;
+      char *rhs;
+      int length;
+    } parse_rules[] = {
+      { "$accept", "program $end", 2 },
+      { "program", "class_list", 1 },
+      { "class_list", "class", 1 },
+      { "class_list", "class_list class", 2 },
+      { "class_list", "error ';' class_list", 3 },
+      { "class", "CLASS TYPEID '{' feature_list '}' ';'", 6 },
+      { "class", "CLASS TYPEID INHERITS TYPEID '{' feature_list '}' ';'", 8 },
+      { "feature_list", "", 0 },
+      { "feature_list", "feature", 1 },
+      { "feature_list", "feature_list feature", 2 },
+      { "feature_list", "error ';' feature_list", 3 },
+      { "feature", "OBJECTID '(' formal_list ')' ':' TYPEID '{' expr '}' ';'",
+        10 },
+      { "feature", "OBJECTID ':' TYPEID ';'", 4 },
+      { "feature", "OBJECTID ':' TYPEID ASSIGN expr ';'", 6 },
+      { "formal_list", "", 0 },
+      { "formal_list", "formal", 1 },
+      { "formal_list", "formal_list ',' formal", 3 },
+      { "formal", "OBJECTID ':' TYPEID", 3 },
+      { "case_branch", "OBJECTID ':' TYPEID DARROW expr ';'", 6 },
+      { "case_branches", "case_branch", 1 },
+      { "case_branches", "case_branches case_branch", 2 },
+      { "block_exprs", "expr ';'", 2 },
+      { "block_exprs", "block_exprs expr ';'", 3 },
+      { "block_exprs", "error ';' block_exprs", 3 },
+      { "dispt_exprs", "", 0 },
+      { "dispt_exprs", "expr", 1 },
+      { "dispt_exprs", "dispt_exprs ',' expr", 3 },
+      { "let_list", "OBJECTID ':' TYPEID IN expr", 5 },
+      { "let_list", "OBJECTID ':' TYPEID ASSIGN expr IN expr", 7 },
+      { "let_list", "OBJECTID ':' TYPEID ',' let_list", 5 },
+      { "let_list", "OBJECTID ':' TYPEID ASSIGN expr ',' let_list", 7 },
+      { "let_list", "error", 1 },
+      { "expr", "OBJECTID ASSIGN expr", 3 },
+      { "expr", "expr '.' OBJECTID '(' dispt_exprs ')'", 6 },
+      { "expr", "expr '@' TYPEID '.' OBJECTID '(' dispt_exprs ')'", 8 },
+      { "expr", "OBJECTID '(' dispt_exprs ')'", 4 },
+      { "expr", "IF expr THEN expr ELSE expr FI", 7 },
+      { "expr", "WHILE expr LOOP expr POOL", 5 },
+      { "expr", "'{' block_exprs '}'", 3 },
+      { "expr", "'{' error '}'", 3 },
+      { "expr", "LET let_list", 2 },
+      { "expr", "CASE expr OF case_branches ESAC", 5 },
+      { "expr", "NEW TYPEID", 2 },
+      { "expr", "ISVOID expr", 2 },
+      { "expr", "expr '+' expr", 3 },
+      { "expr", "expr '-' expr", 3 },
+      { "expr", "expr '*' expr", 3 },
+      { "expr", "expr '/' expr", 3 },
+      { "expr", "'~' expr", 2 },
+      { "expr", "expr '<' expr", 3 },
+      { "expr", "expr LE expr", 3 },
+      { "expr", "expr '=' expr", 3 },
+      { "expr", "NOT expr", 2 },
+      { "expr", "'(' expr ')'", 3 },
+      { "expr", "OBJECTID", 1 },
+      { "expr", "INT_CONST", 1 },
+      { "expr", "STR_CONST", 1 },
+      { "expr", "BOOL_CONST", 1 },
+    };
+    
+    #define PARSE_RULES ((int) (sizeof(parse_rules) / sizeof(parse_rules[0])))
+    typedef char parse_stats_has_room_for_the_rules
+      [PARSE_RULES <= MAX_PARSE_RULES ? 1 : -1];
+    
+    /* Count a reduction by rule, and the depth of the stack after it.
+    stats->depth counts the symbols on the stack and the lookahead, if
+    there is one: the rule's symbols, under the lookahead, are replaced
+    by the one it reduces to.  After a syntax error, bison pops symbols
+    and drops tokens unseen, so the depth is counted only until then. */
+    static void count_reduction(parse_context *ctx, int rule, int lookahead)
     {
-      extern int curr_lineno;
+      parse_stats *stats = ctx->stats;
       
-      cerr << "\"" << curr_filename << "\", line " << curr_lineno << ": " \
-      << s << " at or near ";
-      print_cool_token(yychar);
-      cerr << endl;
-      omerrs++;
+      stats->reductions[rule]++;
+      stats->depth -= parse_rules[rule].length - 1;
+      /* the symbols, and the state at the bottom of the stack */
+      int entries = stats->depth - lookahead + 1;
+      if (ctx->errors == 0 && entries > stats->max_depth)
+        stats->max_depth = entries;
+    }
+    
+    /* The sides of rule; 0 if there is no such rule.  The rules of cool.y
+    are numbered from 1. */
+    int describe_parse_rule(int rule, char **lhs, char **rhs)
+    {
+      if (rule < 1 || rule >= PARSE_RULES)
+        return 0;
+      *lhs = parse_rules[rule].lhs;
+      *rhs = parse_rules[rule].rhs;
+      return 1;
+    }
+    
+    /* This function is called automatically when Bison detects a parse error. */
+    void yyerror(YYLTYPE *loc, parse_context *ctx, const char *s)
+    {
+      if (ctx->errors > MAX_PARSE_ERRORS)
+        return;
+      ctx->errors++;
+      ctx->report_error(ctx, (char *) s);
+    }
+    
+    void init_parse_context(parse_context *ctx, char *filename,
+          int (*read_token)(parse_context *ctx, YYSTYPE *lval, int *lineno),
+          void *data)
+    {
+      ctx->filename = filename;
+      ctx->read_token = read_token;
+      ctx->report_error = print_parse_context_error;
+      ctx->data = data;
+      ctx->stats = NULL;
+      ctx->token = 0;
+      ctx->lineno = 0;
+      ctx->errors = 0;
+      ctx->classes = NULL;
+      ctx->program = NULL;
+    }
+    
+    void print_parse_context_error(parse_context *ctx, char *msg)
+    {
+      print_parse_error(cerr, ctx->filename, ctx->lineno, msg,
+                        ctx->token, &ctx->lval);
+    }
+    
+    /* cool_yyparse() parses the tokens of cool_yylex, as the parser always
+    has, into the globals above; with -S, it counts in cool_yyparse_stats. */
+    parse_stats cool_yyparse_stats;
+    
+    static int read_cool_yylex(parse_context *ctx, YYSTYPE *lval, int *lineno)
+    {
+      extern char *curr_filename;
       
-      if(omerrs>50) {fprintf(stdout, "More than 50 errors\n"); exit(1);}
+      int token = yylex();
+      *lval = cool_yylval;
+      *lineno = curr_lineno;
+      ctx->filename = curr_filename;  /* a token stream names its file */
+      return token;
     }
     
+    static void exit_after_too_many(parse_context *ctx, char *msg)
+    {
+      print_parse_context_error(ctx, msg);
+      if (omerrs + ctx->errors > MAX_PARSE_ERRORS) {
+        fprintf(stdout, "More than 50 errors\n");
+        exit(1);
+      }
+    }
     
+    int yyparse()
+    {
+      extern char *curr_filename;
+      parse_context ctx;
+      
+      init_parse_context(&ctx, curr_filename, read_cool_yylex, NULL);
+      ctx.report_error = exit_after_too_many;
+      if (parser_stats)
+        ctx.stats = &cool_yyparse_stats;
+      int result = pratt_parser ? pratt_parse(&ctx) : yyparse(&ctx);
+      omerrs += ctx.errors;
+      if (ctx.classes != NULL)
+        parse_results = ctx.classes;
+      if (ctx.program != NULL)
+        ast_root = ctx.program;
+      return result;
+    }
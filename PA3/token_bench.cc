@@ -0,0 +1 @@
+/usr/class/cs143/cool/src/PA3/token_bench.cc
\ No newline at end of file
@@ -0,0 +1 @@
+/usr/class/cs143/cool/src/PA4/cache_test.sh
\ No newline at end of file
@@ -833,4 +833,19 @@ Expression no_expr();
 Expression object(Symbol);
 
 
+// The kinds of node, as ast_node_counts counts them (see tree.h): list
+// nodes are NODE_list, and each of the other kinds is made by the
+// constructor function of the same name.
+enum ast_node_kind {
+  NODE_list, NODE_program, NODE_class_, NODE_method, NODE_attr,
+  NODE_formal, NODE_branch, NODE_assign, NODE_static_dispatch,
+  NODE_dispatch, NODE_cond, NODE_loop, NODE_typcase, NODE_block,
+  NODE_let, NODE_plus, NODE_sub, NODE_mul, NODE_divide, NODE_neg,
+  NODE_lt, NODE_eq, NODE_leq, NODE_comp, NODE_int_const,
+  NODE_bool_const, NODE_string_const, NODE_new_, NODE_isvoid,
+  NODE_no_expr, NODE_object, NODE_KINDS
+};
+extern char *ast_node_kind_names[NODE_KINDS];
+
+
 #endif
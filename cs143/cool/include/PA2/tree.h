@@ -15,9 +15,81 @@
 ///////////////////////////////////////////////////////////////////////////
  
 
+#include <stddef.h>
 #include "stringtab.h"
 #include "cool-io.h"
 
+/////////////////////////////////////////////////////////////////////
+//
+//  ast_arena
+//
+//   Tree nodes are not allocated one by one on the heap: every node
+//   (including list nodes, and the nodes made by copy()) is allocated
+//   from the current ast_arena, by bumping a pointer in a large chunk.
+//   Nodes are laid out in the order they are built.  The parser builds
+//   the children of a node just before the node itself, so a node and
+//   its children usually share a cache line or two, which helps the
+//   tree walks of semant and cgen.
+//
+//   An arena holds the nodes of one compilation unit.  They are freed
+//   all at once, without running destructors, by release() or by the
+//   arena's destructor; delete on a single node does nothing.  The
+//   nodes of an arena must not be used after it is released.
+//
+//       ast_arena *current_ast_arena;
+//         the arena new nodes come from; initially default_ast_arena,
+//         which lives until the program exits.  Each thread has its own
+//         current arena, so threads that build trees at the same time
+//         (e.g. parsing several files at once) must each set an arena.
+//
+//       ast_arena *set_ast_arena(ast_arena *a);
+//         makes a the current arena and returns the previous one.
+//
+//       void *alloc(int size);
+//         returns size bytes of storage in the arena.
+//
+//       void release();
+//         frees all the storage of the arena; it may then be reused.
+//
+//       int size();
+//         returns the number of bytes allocated from the arena.
+//
+/////////////////////////////////////////////////////////////////////
+
+#define AST_ARENA_ALIGN      8
+#define AST_ARENA_ROUND(n)   (((n) + AST_ARENA_ALIGN - 1) & ~(AST_ARENA_ALIGN - 1))
+#define AST_ARENA_CHUNK_SIZE 65536
+
+class ast_arena {
+private:
+    char *next;         // first free byte of the current chunk
+    char *limit;        // end of the current chunk
+    char *chunks;       // chunks in use, newest first, linked through
+                        // their first word
+    int nbytes;         // bytes handed out
+    void new_chunk(int size);
+public:
+    ast_arena() : next(NULL), limit(NULL), chunks(NULL), nbytes(0) { }
+    ~ast_arena() { release(); }
+
+    void *alloc(int size)
+    {
+	size = AST_ARENA_ROUND(size);
+	if (limit - next < size)
+	    new_chunk(size);
+	void *p = next;
+	next += size;
+	nbytes += size;
+	return p;
+    }
+    void release();
+    int size() { return nbytes; }
+};
+
+extern ast_arena default_ast_arena;
+extern __thread ast_arena *current_ast_arena;
+ast_arena *set_ast_arena(ast_arena *a);
+
 /////////////////////////////////////////////////////////////////////
 //
 //  tree_node
@@ -47,8 +119,18 @@
 //           sets the line number and type of "this" to the values in
 //           the argument tree_node.  Returns "this".
 //
+//   operator new allocates nodes from current_ast_arena, and operator
+//   delete leaves them to be freed with the arena.
+//
+//   int *ast_node_counts;
+//     if not NULL, new nodes are counted here, by kind: the constructor
+//     functions of cool-tree.cc count theirs at the index of their
+//     ast_node_kind (see cool-tree.h), and list nodes are all counted
+//     at index 0.  Like current_ast_arena, it is per thread.
 //
 ////////////////////////////////////////////////////////////////////////////
+extern __thread int *ast_node_counts;
+
 class tree_node {
 protected:
     int line_number;            // stash the line number when node is made
@@ -59,6 +141,9 @@ public:
     virtual void dump(ostream& stream, int n) = 0;
     int get_line_number();
     tree_node *set(tree_node *);
+
+    void *operator new(size_t size) { return current_ast_arena->alloc(size); }
+    void operator delete(void *)    { }
 };
 
 ///////////////////////////////////////////////////////////////////
@@ -78,7 +163,9 @@ public:
 //
 //     Elem nth(int n);
 //     returns the nth element of a list.  If the list has fewer than n
-//     elements, an error is generated.
+//     elements, an error is generated.  nth takes constant time, except
+//     that the first call on a list built by append copies its elements
+//     into an array (see below).
 //
 //     int first();
 //     int next(int n);
@@ -91,7 +178,18 @@ public:
 //
 //      
 //     int len()
-//     returns the length of the list
+//     returns the length of the list, in constant time
+//
+//     Elem *elems();
+//     typedef Elem *iterator;
+//     iterator begin();
+//     iterator end();
+//     elems returns the elements of the list in a contiguous array of
+//     len() elements.  begin and end are a forward iterator over that
+//     array:
+//
+//     for(list_node<Elem>::iterator p = l->begin(); p != l->end(); ++p)
+//         ... operate on *p ...
 //
 //     nth_length(int n, int &len);
 //     Returns the nth element of the list or NULL if there are not n elements.
@@ -103,17 +201,43 @@ public:
 //     static list_node<Elem> *append(list_node<Elem> *, list_node<Elem> *);
 //
 //     These three functions construct an empty list, a list of one element,
-//     and append two lists, respectively.  Note that the functions are static;
+//     and append two lists, respectively.  append takes constant time and
+//     does not look at the elements: an append_node records its two
+//     halves and their total length.  A list built one element at a time
+//     by append is a chain as deep as the list is long.  The first call
+//     to nth or elems on an append_node flattens the chain (without
+//     recursion) into an array that the node keeps; lists are never
+//     modified, so the array stays valid.  Note that the functions are static;
 //     there is no "this" parameter.  Example uses:
 //
 //     list_node<Elem>::nil();
 //     list_node<Elem>::single(e);     where "e" has type Elem
 //     list_node<Elem>::append(l1,l2);
 //
+//     list_node<Elem> *extend_list(list_node<Elem> *l, Elem e);
+//
+//     returns the elements of l followed by e, as a flat_list_node: one
+//     array, with room to grow.  If l is already a flat_list_node, e is
+//     added to it in place, in amortized constant time, and l is returned;
+//     like the pointer given to realloc, l must not be used otherwise.
+//     This is how the parser builds its lists, so that a list of n
+//     elements is one node over one array, not a chain of n appends.
+//
 //////////////////////////////////////////////////////////////////////////////
 
+template <class Elem> class append_node;
+template <class Elem> class flat_list_node;
+
 template <class Elem> class list_node : public tree_node {
 public:
+    typedef Elem *iterator;
+
+    list_node()
+    {
+	if (ast_node_counts != NULL)
+	    ast_node_counts[0]++;
+    }
+
     tree_node *copy()            { return copy_list(); }
     Elem nth(int n);
     //
@@ -123,10 +247,16 @@ public:
     int next(int n)  { return n + 1; }
     int more(int n)  { return (n < len()); }
 
+    iterator begin() { return elems(); }
+    iterator end()   { return elems() + len(); }
+
     virtual list_node<Elem> *copy_list() = 0;
     virtual ~list_node() { }
     virtual int len() = 0;
     virtual Elem nth_length(int n, int &len) = 0;
+    virtual Elem *elems() = 0;
+    virtual append_node<Elem> *as_append() { return NULL; }
+    virtual flat_list_node<Elem> *as_flat() { return NULL; }
 
     static list_node<Elem> *nil();
     static list_node<Elem> *single(Elem);
@@ -142,6 +272,7 @@ public:
     list_node<Elem> *copy_list();
     int len();
     Elem nth_length(int n, int &len);
+    Elem *elems()    { return NULL; }
     void dump(ostream& stream, int n);
 };
 
@@ -154,6 +285,7 @@ public:
     list_node<Elem> *copy_list();
     int len();
     Elem nth_length(int n, int &len);
+    Elem *elems()    { return &elem; }
     void dump(ostream& stream, int n);
 };
 
@@ -161,15 +293,40 @@ public:
 template <class Elem> class append_node : public list_node<Elem> {
 private:
     list_node<Elem> *some, *rest;
+    int count;          // some->len() + rest->len()
+    Elem *flat;         // the elements, once flattened; NULL before
+    ast_arena *arena;   // the arena holding this node, and flat
 public:
     append_node(list_node<Elem> *l1, list_node<Elem> *l2) {
 	some = l1;
 	rest = l2;
+	count = l1->len() + l2->len();
+	flat = NULL;
+	arena = current_ast_arena;
     }
     list_node<Elem> *copy_list();
     int len();
     Elem nth(int n);
     Elem nth_length(int n, int &len);
+    Elem *elems();
+    append_node<Elem> *as_append() { return this; }
+    void dump(ostream& stream, int n);
+};
+
+template <class Elem> class flat_list_node : public list_node<Elem> {
+private:
+    Elem *elem;         // the elements, in an array of size slots
+    int count;
+    int size;
+    ast_arena *arena;   // the arena holding this node, and elem
+public:
+    flat_list_node(Elem *e, int n);     // a copy of the n elements at e
+    void add(Elem x);
+    list_node<Elem> *copy_list();
+    int len();
+    Elem nth_length(int n, int &len);
+    Elem *elems()    { return elem; }
+    flat_list_node<Elem> *as_flat() { return this; }
     void dump(ostream& stream, int n);
 };
 
@@ -177,6 +334,7 @@ public:
 template <class Elem> single_list_node<Elem> *list(Elem x);
 template <class Elem> append_node<Elem> *cons(Elem x, list_node<Elem> *l);
 template <class Elem> append_node<Elem> *xcons(list_node<Elem> *l, Elem x);
+template <class Elem> list_node<Elem> *extend_list(list_node<Elem> *l, Elem x);
 
 
 template <class Elem> list_node<Elem> *list_node<Elem>::nil() { return new nil_node<Elem>(); }
@@ -353,7 +511,7 @@ template <class Elem> list_node<Elem> *append_node<Elem>::copy_list()
 ///////////////////////////////////////////////////////////////////////////
 template <class Elem> int append_node<Elem>::len()
 {
-    return some->len() + rest->len();
+    return count;
 }
 
 
@@ -366,14 +524,59 @@ template <class Elem> int append_node<Elem>::len()
 ///////////////////////////////////////////////////////////////////////////
 template <class Elem> Elem append_node<Elem>::nth_length(int n, int &len)
 {
-    int rlen;
-    Elem tmp = some->nth_length(n, len);
+    len = count;
+    if (n < 0 || n >= count)
+	return NULL;
+    return elems()[n];
+}
 
-    if (!tmp) {
-	tmp = rest->nth_length(n-len, rlen);
-	len += rlen;
+
+///////////////////////////////////////////////////////////////////////////
+//
+// append_node::elems
+//
+// flatten the list into an array, the first time it is needed.  The
+// nodes still to be visited are kept on an explicit stack, so that long
+// chains of appends do not exhaust the C++ stack.  Parts of the list that
+// were flattened earlier are copied as they are.  The array is allocated
+// in the node's own arena, so that it is freed along with the node.
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> Elem *append_node<Elem>::elems()
+{
+    if (flat != NULL || count == 0)
+	return flat;
+
+    Elem *out = (Elem *) arena->alloc(count * sizeof(Elem));
+    int k = 0;
+    int size = 64;
+    int top = 0;
+    list_node<Elem> **stack = new list_node<Elem> *[size];
+
+    stack[top++] = this;
+    while (top > 0) {
+	list_node<Elem> *l = stack[--top];
+	append_node<Elem> *a = l->as_append();
+	if (a != NULL && a->flat == NULL && a->count > 0) {
+	    if (top + 2 > size) {
+		list_node<Elem> **bigger = new list_node<Elem> *[2 * size];
+		for (int i = 0; i < top; i++)
+		    bigger[i] = stack[i];
+		delete [] stack;
+		stack = bigger;
+		size *= 2;
+	    }
+	    stack[top++] = a->rest;
+	    stack[top++] = a->some;
+	} else {
+	    Elem *e = l->elems();
+	    for (int i = 0; i < l->len(); i++)
+		out[k++] = e[i];
+	}
     }
-    return tmp;
+    delete [] stack;
+    flat = out;
+    return flat;
 }
 
 
@@ -396,6 +599,107 @@ template <class Elem> void append_node<Elem>::dump(ostream& stream, int n)
 }
 
 
+///////////////////////////////////////////////////////////////////////////
+//
+// flat_list_node::flat_list_node
+//
+// copy n elements into a new array in the current arena, leaving room
+// for as many more
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> flat_list_node<Elem>::flat_list_node(Elem *e, int n)
+{
+    count = n;
+    size = n < 4 ? 8 : 2 * n;
+    arena = current_ast_arena;
+    elem = (Elem *) arena->alloc(size * sizeof(Elem));
+    for (int i = 0; i < n; i++)
+	elem[i] = e[i];
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// flat_list_node::add
+//
+// add an element at the end, doubling the array when it is full.  The
+// old array is left in the arena, to be freed with it.
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> void flat_list_node<Elem>::add(Elem x)
+{
+    if (count == size) {
+	Elem *bigger = (Elem *) arena->alloc(2 * size * sizeof(Elem));
+	for (int i = 0; i < count; i++)
+	    bigger[i] = elem[i];
+	elem = bigger;
+	size *= 2;
+    }
+    elem[count++] = x;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// flat_list_node::copy_list
+//
+// return the deep copy of the flat_list_node
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> list_node<Elem> *flat_list_node<Elem>::copy_list()
+{
+    flat_list_node<Elem> *c = new flat_list_node<Elem>(NULL, 0);
+    for (int i = 0; i < count; i++)
+	c->add((Elem) elem[i]->copy());
+    return c;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// flat_list_node::len
+//
+// return the length of the flat_list_node
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> int flat_list_node<Elem>::len()
+{
+    return count;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// flat_list_node::nth_length
+//
+// return the nth element on the list
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> Elem flat_list_node<Elem>::nth_length(int n, int &len)
+{
+    len = count;
+    if (n < 0 || n >= count)
+	return NULL;
+    return elem[n];
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// flat_list_node::dump
+//
+// dump for list node, as for an append_node
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> void flat_list_node<Elem>::dump(ostream& stream, int n)
+{
+    stream << pad(n) << "list\n";
+    for (int i = 0; i < count; i++)
+      elem[i]->dump(stream, n+2);
+    stream << pad(n) << "(end_of_list)\n";
+}
+
+
 ///////////////////////////////////////////////////////////////////////////
 //
 // list
@@ -428,4 +732,20 @@ template <class Elem> append_node<Elem> *xcons(list_node<Elem> *l, Elem x)
     return new append_node<Elem>(l, list(x));
 }
 
+
+///////////////////////////////////////////////////////////////////////////
+//
+// extend_list
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> list_node<Elem> *extend_list(list_node<Elem> *l, Elem x)
+{
+    flat_list_node<Elem> *f = l->as_flat();
+
+    if (f == NULL)
+	f = new flat_list_node<Elem>(l->elems(), l->len());
+    f->add(x);
+    return f;
+}
+
 #endif /* TREE_H */
@@ -0,0 +1,92 @@
+// -*-Mode: C++;-*-
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+#ifndef _PARSE_CONTEXT_H_
+#define _PARSE_CONTEXT_H_
+
+//
+// The COOL parser (cool.y) is pure: everything it keeps while parsing
+// one input is in a parse_context, so that several inputs can be parsed
+// at once, each on its own thread.
+//
+// The parser takes its tokens from read_token, which returns the next
+// token, or 0 at the end of the input, and sets its value and line
+// number.  It reports each syntax error through report_error, after
+// counting it in errors; the token at fault is the last one read.  It
+// gives up after MAX_PARSE_ERRORS errors, or with "memory exhausted" if
+// the input nests MAX_PARSE_DEPTH deep, and returns nonzero, instead
+// of exiting.  The classes parsed so far are left in classes, and the
+// program, if the parse got that far, in program.
+//
+// The tree nodes are built in the thread's current ast_arena (see
+// tree.h), and the string tables must be in concurrent mode (see
+// stringtab.h) while more than one parse is running.
+//
+// pratt_parse is a hand-written parser (pratt-parse.cc) with the same
+// interface and results, down to the errors it reports.
+//
+// cool_yyparse() is the usual interface for one input at a time: it
+// reads tokens from cool_yylex, reports errors on cerr, and leaves the
+// results in ast_root, parse_results and omerrs.  Like the parser of
+// old, it exits after too many errors.  With -P it uses pratt_parse.
+// With -S it also counts in cool_yyparse_stats.
+//
+// If stats is not NULL, the parser counts in it the tokens it reads and
+// the deepest it nests: the most entries on bison's stack after a
+// reduction, up to the first syntax error, or the most expressions and
+// let bindings pratt_parse is inside at once.
+// Bison also counts its reductions by rule; describe_parse_rule gives
+// the two sides of a rule of cool.y.  The caller counts the rest,
+// around the parse (see parser-phase.cc).
+//
+
+#include "cool-parse.h"
+
+#define MAX_PARSE_ERRORS 50
+#define MAX_PARSE_RULES  128
+#define MAX_PARSE_DEPTH  10000     // bison's YYMAXDEPTH
+
+struct parse_stats {
+  int tokens;                    // the tokens read
+  int reductions[MAX_PARSE_RULES];  // by bison's rule number
+  int max_depth;                 // the deepest the parser nested
+  int depth;                     // the symbols on bison's stack, and
+                                 //   its lookahead, during a parse
+  int nodes[NODE_KINDS];         // the tree nodes made, by kind
+  int bytes;                     // the bytes they took
+  double seconds;                // the wall time of the parse
+};
+
+struct parse_context {
+  char *filename;                // the name of the file being parsed
+  int (*read_token)(parse_context *ctx, YYSTYPE *lval, int *lineno);
+  void (*report_error)(parse_context *ctx, char *msg);
+  void *data;                    // for read_token and report_error
+  parse_stats *stats;            // counts the parse, if not NULL
+
+  int token;                     // the last token read,
+  YYSTYPE lval;                  //   its value
+  int lineno;                    //   and line number
+
+  int errors;                    // the number of syntax errors
+  Classes classes;               // the classes parsed so far
+  Program program;               // the program, once it is parsed
+};
+
+extern void init_parse_context(parse_context *ctx, char *filename,
+      int (*read_token)(parse_context *ctx, YYSTYPE *lval, int *lineno),
+      void *data);
+extern int cool_yyparse(parse_context *ctx);
+extern int pratt_parse(parse_context *ctx);
+extern int cool_yyparse();
+extern parse_stats cool_yyparse_stats;
+extern int describe_parse_rule(int rule, char **lhs, char **rhs);
+
+// The default report_error: print the error on cerr.
+extern void print_parse_context_error(parse_context *ctx, char *msg);
+
+#endif
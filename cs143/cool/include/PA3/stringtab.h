@@ -10,12 +10,15 @@
 #define _STRINGTAB_H_
 
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include "list.h"    // list template
 #include "cool-io.h"
 
 class Entry;
 typedef Entry* Symbol;
+template <class Elem> class StringTable;
 
 extern ostream& operator<<(ostream& s, const Entry& sym);
 extern ostream& operator<<(ostream& s, Symbol sym);
@@ -31,8 +34,13 @@ protected:
   char *str;     // the string
   int  len;      // the length of the string (without trailing \0)
   int index;     // a unique index for each string
+  unsigned int hash;  // hash of str; keys the string table's hash index
 public:
   Entry(char *s, int l, int i);
+  // as above, but copy the string into buf (len+1 bytes) instead of
+  // allocating storage for it.  If buf is s, the entry uses the
+  // (null terminated) string in place.
+  Entry(char *s, int l, int i, char *buf);
 
   // is string argument equal to the str of this Entry?
   int equal_string(char *s, int len) const;  
@@ -45,8 +53,23 @@ public:
   // Return the str and len components of the Entry.
   char *get_string() const;
   int get_len() const;
+
+  // Return the cached hash of the string.
+  unsigned int get_hash() const             { return hash; }
+
+  // Return the index of the Entry in its table.
+  int get_index() const                     { return index; }
+
+  // String tables renumber entries interned concurrently.
+  template <class Elem> friend class StringTable;
 };
 
+//
+// hash_string computes the hash of the first len characters of s.
+// Entries cache this value so the string tables never rehash them.
+//
+extern unsigned int hash_string(char *s, int len);
+
 //
 // There are three kinds of string table entries:
 //   a true string, an string representation of an identifier, and 
@@ -65,11 +88,13 @@ public:
   void code_def(ostream& str, int stringclasstag);
   void code_ref(ostream& str);
   StringEntry(char *s, int l, int i);
+  StringEntry(char *s, int l, int i, char *buf);
 };
 
 class IdEntry : public Entry {
 public:
   IdEntry(char *s, int l, int i);
+  IdEntry(char *s, int l, int i, char *buf);
 };
 
 class IntEntry: public Entry {
@@ -77,26 +102,191 @@ public:
   void code_def(ostream& str, int intclasstag);
   void code_ref(ostream& str);
   IntEntry(char *s, int l, int i);
+  IntEntry(char *s, int l, int i, char *buf);
 };
 
 typedef StringEntry *StringEntryP;
 typedef IdEntry *IdEntryP;
 typedef IntEntry *IntEntryP;
 
+//////////////////////////////////////////////////////////////////////////
+//
+//  String Arenas
+//
+//  A StringArena is a bump-pointer allocator for string table storage.
+//  Memory is taken from the heap in large chunks and is never freed,
+//  since entries live as long as the tables do.  Each string table
+//  allocates an entry, its list cell and its characters as one block,
+//  so interning a new string costs a single pointer bump.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#define ARENA_ALIGN      8
+#define ARENA_ROUND(n)   (((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#define ARENA_CHUNK_SIZE 65536
+
+class StringArena {
+private:
+  char *next;     // first free byte of the current chunk
+  char *limit;    // end of the current chunk
+  void new_chunk(int size);
+public:
+  StringArena() : next((char *) NULL), limit((char *) NULL) { }
+
+  void *alloc(int size)
+  {
+    size = ARENA_ROUND(size);
+    if (limit - next < size)
+      new_chunk(size);
+    void *p = next;
+    next += size;
+    return p;
+  }
+};
+
+//
+// stringtab_allocs counts the heap allocations made on behalf of the
+// string tables (arena chunks and index arrays).  It is for measurement
+// only; see stringtab_bench.  It is updated atomically since shards
+// allocate from several threads.
+//
+extern int stringtab_allocs;
+#define COUNT_STRINGTAB_ALLOC() __sync_fetch_and_add(&stringtab_allocs, 1)
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  String Indices
+//
+//  A StringIndex is an open-addressing (linear probing) hash index over
+//  string table entries, keyed by the hash cached in each Entry.  It is
+//  kept at most half full and its size is always a power of two.
+//
+//////////////////////////////////////////////////////////////////////////
+
+template <class Elem>
+class StringIndex
+{
+private:
+   Elem **slots;      // NULL or an entry
+   int size;          // number of slots
+   int count;         // number of entries
+   void grow();       // double the number of slots
+public:
+   StringIndex(): slots((Elem **) NULL), size(0), count(0) { }
+
+   // make room for n entries in all without growing again
+   void reserve(int n);
+
+   // return the entry for the string s of length len and hash h, or NULL
+   Elem *find(char *s, int len, unsigned int h);
+
+   // add an entry that is not yet in the index
+   void insert(Elem *e);
+};
+
+//
+// An IntIndex maps integers to the entries for their decimal string
+// form, so that add_int neither formats nor compares strings once an
+// integer has been seen.  Integers in [0, SMALL_INT_CACHE) are looked up
+// in a direct-mapped array; others in an open-addressing hash table.
+//
+#define SMALL_INT_CACHE 1024
+
+template <class Elem>
+class IntIndex
+{
+private:
+   Elem **small;      // small[i] is the entry for i, or NULL
+   int *keys;         // the integers in the hash table
+   Elem **vals;       // their entries, or NULL for an empty slot
+   int size;          // number of slots
+   int count;         // number of entries
+   void grow();       // double the number of slots
+public:
+   IntIndex(): small((Elem **) NULL), keys((int *) NULL),
+               vals((Elem **) NULL), size(0), count(0) { }
+
+   // return the entry for i, or NULL
+   Elem *find(int i)
+   {
+      if (i >= 0 && i < SMALL_INT_CACHE)
+	 return small ? small[i] : (Elem *) NULL;
+      return find_large(i);
+   }
+   Elem *find_large(int i);
+
+   // record that e is the entry for i
+   void insert(int i, Elem *e);
+};
+
+//
+// A StringShard holds the strings interned into one slice of the hash
+// space while a table is in concurrent mode.  See StringTable below.
+//
+#define STRTAB_SHARDS 16
+
+template <class Elem>
+class StringShard
+{
+public:
+   pthread_mutex_t lock;     // guards everything below
+   StringIndex<Elem> index;  // entries of this shard
+   StringArena arena;        // their storage
+   List<Elem> *added;        // their list cells, newest first
+   int count;                // how many there are
+
+   StringShard(): added((List<Elem> *) NULL), count(0)
+      { pthread_mutex_init(&lock, NULL); }
+   ~StringShard() { pthread_mutex_destroy(&lock); }
+};
+
 //////////////////////////////////////////////////////////////////////////
 //
 //  String Tables
 //
 //////////////////////////////////////////////////////////////////////////
 
+//
+// The list `tbl' holds the entries, newest first, and defines the order
+// used by print and code_string_table.  `hashidx' indexes the same
+// entries by string so that add_string and lookup_string do not have to
+// scan the list.  `entries' is a dense array mapping each index to its
+// entry, so that lookup(i) and the first/more/next iterator take constant
+// time per element.
+//
+// Concurrent mode.  A table is normally for use by one thread.  Between
+// begin_concurrent() and canonicalize(), add_string and lookup_string
+// may be called from any number of threads and return the same entry
+// for equal strings.  Strings that are new in this period go into one of
+// STRTAB_SHARDS shards, chosen by hash, each with its own lock; the
+// entries already in the table are only read.  New entries get no index
+// until canonicalize(), which is called after all threads are done and
+// numbers them in sorted string order after the existing entries.  The
+// resulting indices, and so the labels generated from them, do not
+// depend on thread scheduling.
+//
 template <class Elem> 
 class StringTable
 {
 protected:
    List<Elem> *tbl;   // a string table is a list
    int index;         // the current index
+   StringIndex<Elem> hashidx;  // hash index over the entries of tbl
+   IntIndex<Elem> intidx;      // entries of tbl found by add_int
+   Elem **entries;    // entries[i] is the entry with index i
+   int capacity;      // number of slots in entries
+   StringArena arena; // storage for entries, list cells and strings
+   StringShard<Elem> *shards;  // non-NULL in concurrent mode
+
+   // create an entry and its list cell, which is linked in front of rest
+   static List<Elem> *make_entry(StringArena &a, char *s, int len, int ind,
+				 List<Elem> *rest);
+   Elem *add_shared(char *s, int len, unsigned int h);
+   void append(Elem *e);                          // add e to entries
 public:
-   StringTable(): tbl((List<Elem> *) NULL), index(0) { }   // an empty table
+   StringTable(): tbl((List<Elem> *) NULL), index(0),
+                  entries((Elem **) NULL), capacity(0),
+                  shards((StringShard<Elem> *) NULL) { }   // an empty table
    // The following methods each add a string to the string table.  
    // Only one copy of each string is maintained.  
    // Returns a pointer to the string table entry with the string.
@@ -104,6 +294,9 @@ public:
    // add the prefix of s of length maxchars
    Elem *add_string(char *s, int maxchars);
 
+   // add the len characters at s, which need not be null terminated
+   Elem *add_chars(char *s, int len);
+
    // add the (null terminated) string s
    Elem *add_string(char *s);
 
@@ -121,6 +314,16 @@ public:
 
    void print();  // print the entire table; for debugging
 
+   // Concurrent mode; see above.
+   void begin_concurrent();
+   void canonicalize();
+
+   // Binary form; see stringtab.cc.  load_binary fills an empty table
+   // from a section written by write_binary, using the strings where
+   // they lie, or copies of them if copy is set.  It returns the end of
+   // the section, or NULL if the section is malformed.
+   void write_binary(FILE *f);
+   char *load_binary(char *p, char *end, int copy);
 };
 
 class IdTable : public StringTable<IdEntry> { };
@@ -140,4 +343,13 @@ public:
 extern IdTable idtable;
 extern IntTable inttable;
 extern StrTable stringtable;
+
+// Enter and leave concurrent mode for all three tables.
+extern void begin_concurrent_interning();
+extern void canonicalize_interning();
+
+// Save and restore all three tables in binary form.  The reader
+// returns 0 if the input is not a valid string table file.
+extern void write_string_tables(FILE *f);
+extern int read_string_tables(FILE *f);
 #endif
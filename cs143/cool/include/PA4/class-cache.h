@@ -0,0 +1,32 @@
+// -*-Mode: C++;-*-
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+#ifndef _CLASS_CACHE_H_
+#define _CLASS_CACHE_H_
+
+//
+// coolc -i keeps the classes it parses in a cache directory, and lexes
+// and parses again only the classes whose text has changed since (see
+// class-cache.cc).
+//
+// parse_cached_classes finds the classes in the len bytes at text, which
+// end in two NULs (see map_source_file in utilities.h), lexes with lx
+// and parses the classes that are not in the cache, and leaves the
+// file's classes and program in ctx, as a parse of the whole file
+// would.  It returns 0 if the file must be parsed whole after all: if it
+// has lexical or syntax errors, or anything before its first class.  The
+// caller then starts the lexer on the whole text, and parses it as
+// usual, to report the errors.
+//
+
+#include "cool-lex.h"
+#include "parse-context.h"
+
+extern int parse_cached_classes(parse_context *ctx, cool_lexer *lx,
+				char *text, size_t len, char *dir);
+
+#endif
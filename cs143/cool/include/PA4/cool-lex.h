@@ -0,0 +1,62 @@
+// -*-Mode: C++;-*-
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+#ifndef _COOL_LEX_H_
+#define _COOL_LEX_H_
+
+//
+// The COOL scanner (cool.flex) is reentrant: all of its state is kept in
+// a cool_lexer, so that several inputs can be scanned at once, each by
+// its own lexer and thread.  A lexer scans one input at a time, from a
+// file or from mapped text (see map_source_file in utilities.h), and
+// returns each token's value and line number in lval and lineno rather
+// than in cool_yylval and curr_lineno.
+//
+// The lexers share the string tables, which must be in concurrent mode
+// (see begin_concurrent_interning in stringtab.h) while more than one
+// lexer is running.
+//
+// cool_yylex() is the usual interface for one input at a time; it runs a
+// lexer of its own on fin and copies out cool_yylval and curr_lineno.
+//
+
+#include <stdio.h>
+#include "cool-parse.h"
+
+/* Max size of string constants */
+#define MAX_STR_CONST 1025
+
+struct cool_lexer {
+  FILE *fin;                        // the input, unless scanning text
+  int lineno;                       // the current line number
+  YYSTYPE lval;                     // the value of the last token
+  int nesting;                      // depth of nested comments
+  int str_len;                      // length of the string constant
+  int str_nul;                      // does the string contain a NUL?
+  char *string_buf;                 // to assemble string constants;
+  int str_size;                     //   grows up to MAX_STR_CONST - 1
+  void *scanner;                    // flex's own state (a yyscan_t)
+};
+
+extern cool_lexer *new_cool_lexer();
+extern void delete_cool_lexer(cool_lexer *lx);
+
+// Start scanning a file, or mapped text that ends in two NULs, at line 1.
+extern void cool_lexer_file(cool_lexer *lx, FILE *f);
+extern void cool_lexer_text(cool_lexer *lx, char *text, size_t len);
+
+// Return the next token, or 0 at the end of the input.
+extern int cool_lexer_token(cool_lexer *lx);
+
+// A token with its value and line number, as a lexer returns it.
+struct lexed_token {
+  int token;
+  int lineno;
+  YYSTYPE lval;
+};
+
+#endif
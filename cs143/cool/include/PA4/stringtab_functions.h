@@ -7,13 +7,19 @@
 #include "cool-io.h"
 #define MAXSIZE 1000000
 #define min(a,b) (a > b ? b : a)
+#define HASHTBL_INIT_SIZE 64
+#define ENTRIES_INIT_SIZE 64
 
 #include "stringtab.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <new>
 
 //
 // A string table is implemented a linked list of Entrys.  Each Entry
-// in the list has a unique string.
+// in the list has a unique string.  A hash index over the list makes
+// searching by string constant time on average.
 //
 
 template <class Elem>
@@ -23,26 +29,173 @@ Elem *StringTable<Elem>::add_string(char *s)
 }
 
 //
-// Add a string requires two steps.  First, the list is searched; if the
+// StringIndex::find probes the index for the string s of length len,
+// whose hash is h.  It returns the matching Entry, or NULL if there is
+// none.
+//
+template <class Elem>
+Elem *StringIndex<Elem>::find(char *s, int len, unsigned int h)
+{
+  if (slots == NULL)
+    return NULL;
+  int mask = size - 1;
+  for(int i = h & mask; slots[i]; i = (i + 1) & mask)
+    if (slots[i]->get_hash() == h && slots[i]->equal_string(s,len))
+      return slots[i];
+  return NULL;
+}
+
+//
+// StringIndex::insert places a new Entry in the first free slot of its
+// probe sequence, growing the index first if it would become more than
+// half full.
+//
+template <class Elem>
+void StringIndex<Elem>::insert(Elem *e)
+{
+  if (2 * ++count > size)
+    grow();
+  int mask = size - 1;
+  int i = e->get_hash() & mask;
+  while (slots[i])
+    i = (i + 1) & mask;
+  slots[i] = e;
+}
+
+//
+// StringIndex::reserve grows the index once so that it can hold n
+// entries.
+//
+template <class Elem>
+void StringIndex<Elem>::reserve(int n)
+{
+  if (2 * n <= size)
+    return;
+  int saved = count;
+  count = n;
+  grow();
+  count = saved;
+}
+
+//
+// StringIndex::grow doubles the size of the index.  The entries are
+// rehashed using the hash cached in each Entry.
+//
+template <class Elem>
+void StringIndex<Elem>::grow()
+{
+  Elem **old = slots;
+  int oldsize = size;
+
+  size = oldsize ? 2 * oldsize : HASHTBL_INIT_SIZE;
+  while (2 * count > size)
+    size *= 2;
+  slots = new Elem *[size];
+  COUNT_STRINGTAB_ALLOC();
+  for(int i = 0; i < size; i++)
+    slots[i] = NULL;
+
+  int mask = size - 1;
+  for(int i = 0; i < oldsize; i++)
+    if (old[i]) {
+      int j = old[i]->get_hash() & mask;
+      while (slots[j])
+        j = (j + 1) & mask;
+      slots[j] = old[i];
+    }
+  delete [] old;
+}
+
+//
+// make_entry carves a new Entry, its list cell and its characters out of
+// one block of the arena a, in that order.  The cell links the entry in
+// front of rest.
+//
+template <class Elem>
+List<Elem> *StringTable<Elem>::make_entry(StringArena &a, char *s, int len,
+					  int ind, List<Elem> *rest)
+{
+  int hdr = ARENA_ROUND(sizeof(Elem));
+  int cell = ARENA_ROUND(sizeof(List<Elem>));
+  char *mem = (char *) a.alloc(hdr + cell + len + 1);
+  Elem *e = new (mem) Elem(s,len,ind,mem + hdr + cell);
+  return new (mem + hdr) List<Elem>(e, rest);
+}
+
+//
+// append records a new Entry in the dense index array, doubling the
+// array when it is full.  Entries are appended in index order.
+//
+template <class Elem>
+void StringTable<Elem>::append(Elem *e)
+{
+  if (index > capacity) {
+    int newcap = capacity ? 2 * capacity : ENTRIES_INIT_SIZE;
+    Elem **newentries = new Elem *[newcap];
+    COUNT_STRINGTAB_ALLOC();
+    for(int i = 0; i < capacity; i++)
+      newentries[i] = entries[i];
+    delete [] entries;
+    entries = newentries;
+    capacity = newcap;
+  }
+  entries[index - 1] = e;
+}
+
+//
+// Add a string requires two steps.  First, the table is searched; if the
 // string is found, a pointer to the existing Entry for that string is 
 // returned.  If the string is not found, a new Entry is created and added
-// to the list.
+// to the list and to the hash index.  The Entry, its list cell and its
+// characters are carved out of one arena block, in that order.
 //
 template <class Elem>
 Elem *StringTable<Elem>::add_string(char *s, int maxchars)
 {
-  int len = min((int) strlen(s),maxchars);
-  for(List<Elem> *l = tbl; l; l = l->tl())
-    if (l->hd()->equal_string(s,len))
-      return l->hd();
+  return add_chars(s, min((int) strlen(s),maxchars));
+}
+
+template <class Elem>
+Elem *StringTable<Elem>::add_chars(char *s, int len)
+{
+  unsigned int h = hash_string(s,len);
+  Elem *e = hashidx.find(s, len, h);
+  if (e)
+    return e;
+  if (shards)
+    return add_shared(s, len, h);
 
-  Elem *e = new Elem(s,len,index++);
-  tbl = new List<Elem>(e, tbl);
+  tbl = make_entry(arena, s, len, index++, tbl);
+  e = tbl->hd();
+  hashidx.insert(e);
+  append(e);
   return e;
 }
 
 //
-// To look up a string, the list is scanned until a matching Entry is located.
+// add_shared is add_string for a string that is not in the table proper
+// while in concurrent mode.  The string's shard is searched and, if need
+// be, extended under the shard's lock.  The new entry's index is -1
+// until canonicalize.
+//
+template <class Elem>
+Elem *StringTable<Elem>::add_shared(char *s, int len, unsigned int h)
+{
+  StringShard<Elem> *sh = &shards[h % STRTAB_SHARDS];
+  pthread_mutex_lock(&sh->lock);
+  Elem *e = sh->index.find(s, len, h);
+  if (e == NULL) {
+    sh->added = make_entry(sh->arena, s, len, -1, sh->added);
+    e = sh->added->hd();
+    sh->index.insert(e);
+    sh->count++;
+  }
+  pthread_mutex_unlock(&sh->lock);
+  return e;
+}
+
+//
+// To look up a string, the hash index is probed for a matching Entry.
 // If no such entry is found, an assertion failure occurs.  Thus, this function
 // is used only for strings that one expects to find in the table.
 //
@@ -50,36 +203,125 @@ template <class Elem>
 Elem *StringTable<Elem>::lookup_string(char *s)
 {
   int len = strlen(s);
-  for(List<Elem> *l = tbl; l; l = l->tl())
-    if (l->hd()->equal_string(s,len))
-      return l->hd();
-  assert(0);   // fail if string is not found
-  return NULL; // to avoid compiler warning
+  unsigned int h = hash_string(s,len);
+  Elem *e = hashidx.find(s, len, h);
+  if (e == NULL && shards) {
+    StringShard<Elem> *sh = &shards[h % STRTAB_SHARDS];
+    pthread_mutex_lock(&sh->lock);
+    e = sh->index.find(s, len, h);
+    pthread_mutex_unlock(&sh->lock);
+  }
+  assert(e);   // fail if string is not found
+  return e;
 }
 
 //
 // lookup is similar to lookup_string, but uses the index of the string
-// as the key.
+// as the key.  Since indices are dense, this is a single array access.
 //
 template <class Elem>
 Elem *StringTable<Elem>::lookup(int ind)
 {
-  for(List<Elem> *l = tbl; l; l = l->tl())
-    if (l->hd()->equal_index(ind))
-      return l->hd();
-  assert(0);   // fail if string is not found
-  return NULL; // to avoid compiler warning
+  assert(ind >= 0 && ind < index);   // fail if string is not found
+  return entries[ind];
+}
+
+//
+// IntIndex::find_large looks up an integer outside the small range.
+//
+template <class Elem>
+Elem *IntIndex<Elem>::find_large(int i)
+{
+  if (vals == NULL)
+    return NULL;
+  int mask = size - 1;
+  for(int j = ((unsigned int) i * 2654435761u) & mask; vals[j];
+      j = (j + 1) & mask)
+    if (keys[j] == i)
+      return vals[j];
+  return NULL;
+}
+
+template <class Elem>
+void IntIndex<Elem>::insert(int i, Elem *e)
+{
+  if (i >= 0 && i < SMALL_INT_CACHE) {
+    if (small == NULL) {
+      small = new Elem *[SMALL_INT_CACHE];
+      COUNT_STRINGTAB_ALLOC();
+      for(int j = 0; j < SMALL_INT_CACHE; j++)
+	small[j] = NULL;
+    }
+    small[i] = e;
+    return;
+  }
+  if (2 * ++count > size)
+    grow();
+  int mask = size - 1;
+  int j = ((unsigned int) i * 2654435761u) & mask;
+  while (vals[j])
+    j = (j + 1) & mask;
+  keys[j] = i;
+  vals[j] = e;
+}
+
+template <class Elem>
+void IntIndex<Elem>::grow()
+{
+  int *oldkeys = keys;
+  Elem **oldvals = vals;
+  int oldsize = size;
+
+  size = oldsize ? 2 * oldsize : HASHTBL_INIT_SIZE;
+  keys = new int[size];
+  vals = new Elem *[size];
+  COUNT_STRINGTAB_ALLOC();
+  COUNT_STRINGTAB_ALLOC();
+  for(int j = 0; j < size; j++)
+    vals[j] = NULL;
+
+  int mask = size - 1;
+  for(int k = 0; k < oldsize; k++)
+    if (oldvals[k]) {
+      int j = ((unsigned int) oldkeys[k] * 2654435761u) & mask;
+      while (vals[j])
+	j = (j + 1) & mask;
+      keys[j] = oldkeys[k];
+      vals[j] = oldvals[k];
+    }
+  delete [] oldkeys;
+  delete [] oldvals;
 }
 
 //
 // add_int adds the string representation of an integer to the list.
+// Integers seen before are found through intidx without formatting.
+// Otherwise the digits are produced by hand into a local buffer and
+// added as a string, which also finds an equal entry that was added
+// with add_string.  The integer cache is bypassed in concurrent mode.
 //
 template <class Elem>
 Elem *StringTable<Elem>::add_int(int i)
 {
-  static char *buf = new char[20];
-  snprintf(buf, 20, "%d", i);
-  return add_string(buf);
+  Elem *e;
+  if (shards == NULL && (e = intidx.find(i)) != NULL)
+    return e;
+
+  char buf[12];
+  char *p = buf + sizeof(buf);
+  unsigned int u = i < 0 ? 0u - (unsigned int) i : (unsigned int) i;
+  *--p = '\0';
+  do {
+    *--p = '0' + u % 10;
+    u /= 10;
+  } while (u);
+  if (i < 0)
+    *--p = '-';
+
+  e = add_string(p, buf + sizeof(buf) - 1 - p);
+  if (shards == NULL)
+    intidx.insert(i, e);
+  return e;
 }
 template <class Elem>
 int StringTable<Elem>::first()
@@ -105,3 +347,139 @@ void StringTable<Elem>::print()
 {
   list_print(cerr,tbl);
 }
+
+//
+// begin_concurrent puts the table in concurrent mode.
+//
+template <class Elem>
+void StringTable<Elem>::begin_concurrent()
+{
+  assert(shards == NULL);
+  shards = new StringShard<Elem>[STRTAB_SHARDS];
+}
+
+template <class Elem>
+static int compare_cells(const void *a, const void *b)
+{
+  Elem *x = (*(List<Elem> **) a)->hd();
+  Elem *y = (*(List<Elem> **) b)->hd();
+  int n = min(x->get_len(), y->get_len());
+  int c = memcmp(x->get_string(), y->get_string(), n);
+  return c ? c : x->get_len() - y->get_len();
+}
+
+//
+// canonicalize leaves concurrent mode.  The entries interned in the
+// shards are sorted by string and numbered in that order, and their list
+// cells, which live next to them in the shard arenas, are relinked onto
+// the front of tbl.  It must not run concurrently with anything else.
+//
+template <class Elem>
+void StringTable<Elem>::canonicalize()
+{
+  assert(shards);
+  int n = 0;
+  for(int i = 0; i < STRTAB_SHARDS; i++)
+    n += shards[i].count;
+
+  List<Elem> **cells = new List<Elem> *[n];
+  n = 0;
+  for(int i = 0; i < STRTAB_SHARDS; i++)
+    for(List<Elem> *l = shards[i].added; l; l = l->tl())
+      cells[n++] = l;
+  qsort(cells, n, sizeof(List<Elem> *), compare_cells<Elem>);
+
+  for(int i = 0; i < n; i++) {
+    Elem *e = cells[i]->hd();
+    e->index = index++;
+    tbl = new (cells[i]) List<Elem>(e, tbl);
+    hashidx.insert(e);
+    append(e);
+  }
+  delete [] cells;
+  delete [] shards;
+  shards = (StringShard<Elem> *) NULL;
+}
+
+//
+// write_binary writes the table as a section of a string table file:
+//
+//    uint32 count                 number of entries
+//    uint32 blobsize              size of the blob, a multiple of 4
+//    uint32 offsets[count+1]      entry i is blob[offsets[i]..offsets[i+1])
+//    char   blob[blobsize]        the strings, each null terminated
+//
+// Entries appear in index order.  All words are in host byte order.
+//
+template <class Elem>
+void StringTable<Elem>::write_binary(FILE *f)
+{
+  assert(shards == NULL);
+  uint32_t *offsets = new uint32_t[index + 1];
+  uint32_t off = 0;
+  for(int i = 0; i < index; i++) {
+    offsets[i] = off;
+    off += entries[i]->get_len() + 1;
+  }
+  offsets[index] = off;
+
+  uint32_t head[2];
+  head[0] = index;
+  head[1] = (off + 3) & ~3;
+  fwrite(head, sizeof(uint32_t), 2, f);
+  fwrite(offsets, sizeof(uint32_t), index + 1, f);
+  for(int i = 0; i < index; i++)
+    fwrite(entries[i]->get_string(), 1, entries[i]->get_len() + 1, f);
+  for(; off < head[1]; off++)
+    putc('\0', f);
+  delete [] offsets;
+}
+
+//
+// load_binary reads a section written by write_binary starting at p.
+// The entries and their list cells are allocated as one arena block.
+// Unless copy is set, each entry points at its string in the section,
+// so the section must stay mapped for as long as the table is used;
+// with copy, the strings are copied into the arena in one block, and
+// the section may be freed.
+//
+template <class Elem>
+char *StringTable<Elem>::load_binary(char *p, char *end, int copy)
+{
+  assert(index == 0 && shards == NULL);
+  uint32_t *head = (uint32_t *) p;
+  if (end - p < (long) (2 * sizeof(uint32_t)))
+    return NULL;
+  uint32_t count = head[0], blobsize = head[1];
+  uint32_t *offsets = head + 2;
+  char *blob = (char *) (offsets + count + 1);
+  if (count > (uint32_t) (end - p) / sizeof(uint32_t) ||
+      blob > end || blobsize > (uint32_t) (end - blob) ||
+      offsets[count] > blobsize)
+    return NULL;
+  char *next = blob + blobsize;
+  if (copy) {
+    char *strings = (char *) arena.alloc(blobsize);
+    memcpy(strings, blob, blobsize);
+    blob = strings;
+  }
+
+  int hdr = ARENA_ROUND(sizeof(Elem));
+  int cell = ARENA_ROUND(sizeof(List<Elem>));
+  char *mem = (char *) arena.alloc(count * (hdr + cell));
+  entries = new Elem *[count];
+  capacity = count;
+  COUNT_STRINGTAB_ALLOC();
+  hashidx.reserve(count);
+
+  for(uint32_t i = 0; i < count; i++, mem += hdr + cell) {
+    if (offsets[i] >= offsets[i+1] || blob[offsets[i+1] - 1] != '\0')
+      return NULL;
+    char *s = blob + offsets[i];
+    Elem *e = new (mem) Elem(s, offsets[i+1] - offsets[i] - 1, index++, s);
+    tbl = new (mem + hdr) List<Elem>(e, tbl);
+    entries[i] = e;
+    hashidx.insert(e);
+  }
+  return next;
+}
@@ -0,0 +1,75 @@
+// -*-Mode: C++;-*-
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+#ifndef _TOKEN_RING_H_
+#define _TOKEN_RING_H_
+
+//
+// A TokenRing passes tokens from a lexer (cool-lex.h) to the parser in
+// batches.  The lexer runs ahead of the parser, a batch at a time, and
+// leaves each token in a ring of lexed_tokens; next() hands them to the
+// parser in order.
+//
+// The lexer either runs in the parser's thread, lexing a batch whenever
+// the ring runs dry, or in a thread of its own, so that lexing and
+// parsing overlap.  In a thread, the lexer stays up to SIZE tokens
+// ahead, and the two sides meet only once per batch, under the ring's
+// lock.  Since the parser interns strings too, the string tables must
+// then be in concurrent mode (see stringtab.h).
+//
+// A ring lexes one input, from wherever the lexer was started on it,
+// up to and including its end: after the last token, next() returns 0
+// from then on.
+//
+
+#include <pthread.h>
+#include "cool-lex.h"
+
+class TokenRing {
+private:
+  enum { SIZE = 4096,                 // tokens in the ring; a power of 2
+	 BATCH = 256 };               // tokens lexed at a time
+  lexed_token ring[SIZE];
+  cool_lexer *lexer;
+  int threaded;                       // does the lexer have a thread?
+  pthread_t thread;
+
+  // Shared by the two sides, under lock.
+  pthread_mutex_t lock;
+  pthread_cond_t filled;              // the lexer added a batch
+  pthread_cond_t drained;             // the parser made room
+  unsigned long tail;                 // tokens lexed so far
+  unsigned long freed;                // tokens the parser is done with
+  int stop;                           // the parser is done with the ring
+
+  // The parser's side.
+  unsigned long head;                 // tokens handed to the parser
+  unsigned long avail;                // tokens it may take without lock
+
+  int lex_batch(unsigned long pos);
+  void refill();
+  void run_lexer();
+  static void *lexer_thread(void *r);
+public:
+  TokenRing(cool_lexer *lx, int threaded);
+  ~TokenRing();                       // stops the lexer's thread
+
+  // Return the next token and set *lval and *lineno.
+  int next(YYSTYPE *lval, int *lineno)
+  {
+    if (head == avail)
+      refill();
+    lexed_token *t = &ring[head & (SIZE - 1)];
+    if (t->token != 0)
+      head++;
+    *lval = t->lval;
+    *lineno = t->lineno;
+    return t->token;
+  }
+};
+
+#endif
@@ -14,6 +14,8 @@
 #ifndef _SYMTAB_H_
 #define _SYMTAB_H_
 
+#include <string.h>
+#include <new>
 #include "list.h"
 
 //
@@ -32,6 +34,30 @@ public:
   DAT *get_info() const { return info; }
 };
 
+//
+// SymtabChunk is a block of memory in a symbol table's scope regions.
+//    The chunks of a table form a stack, linked through `prev'.
+//    SymtabMark is a position in that stack; a NULL `chunk' stands for
+//    the bottom of the stack.
+//
+
+#define SYMTAB_CHUNK_SIZE 1024
+#define SYMTAB_ALIGN      sizeof(double)
+
+struct SymtabChunk {
+  SymtabChunk *prev;
+  size_t used;
+  union {
+    double align;
+    char bytes[SYMTAB_CHUNK_SIZE];
+  } data;
+};
+
+struct SymtabMark {
+  SymtabChunk *chunk;
+  size_t used;
+};
+
 //
 // SymbolTable<SYM,DAT> describes a symbol table mapping symbols of
 //    type `SYM' to data of type `DAT *'.  It is implemented as a
@@ -41,13 +67,34 @@ public:
 //
 //    `tbl' points to the current top scope.
 //
+//    The entries and list cells of a scope are allocated from a region
+//    that begins when the scope is entered.  Regions are nested like
+//    the scopes, so they are kept on one stack of chunks, and `marks'
+//    records where each scope's region begins.
+//
 //    `enterscope' makes the table point to a new scope whose parent
 //       is the scope it pointed to previously.
 //
 //    `exitscope' makes the table point to the parent scope of the
-//        current scope.  Note that the old child scope is not
-//        deallocated.  One may save the state of a symbol table
-//        at a given point by copying it with `operator ='
+//        current scope, and frees the old child scope's region in one
+//        step: its chunks go back to the table's pool of free chunks.
+//        Memory in use is thus proportional to the symbols visible
+//        in the nested scopes, not to all the scopes ever entered.
+//        The entries returned by `addid' in that scope are freed too.
+//
+//    `snapshot()' saves the state of the table; `restore(s)' makes
+//        the table point to the scopes saved in `s'.  Taking a
+//        snapshot pins every chunk in use, so that `exitscope'
+//        never frees memory a snapshot can see; pinned chunks are
+//        only freed when the table is destroyed.  A snapshot may
+//        be restored any number of times while the table exists.
+//
+//    `operator =' copies the scopes of another table into regions of
+//        this one, so, as before, a copy is not affected by later
+//        changes to the original, and the two may be destroyed in
+//        either order.  Snapshots of this table remain valid.
+//        `snapshot' is cheaper when the table is only to be returned
+//        to an earlier state.
 //
 //    `addid(s,i)' adds a symbol table entry to the current scope of
 //        the symbol table mapping symbol `s' to data `d'.  The old
@@ -76,13 +123,172 @@ class SymbolTable
    typedef SymtabEntry<SYM,DAT> ScopeEntry;
    typedef List<ScopeEntry> Scope;
    typedef List<Scope> ScopeList;
+public:
+   // The saved state of a symbol table; see `snapshot' and `restore'.
+   class Snapshot {
+      friend class SymbolTable;
+      ScopeList *scopes;
+      int depth;
+   public:
+      Snapshot() : scopes(NULL), depth(0) { }
+   };
 private:
    ScopeList  *tbl;
+   int depth;                // number of scopes in tbl
+   SymtabChunk *chunks;      // the region stack, top chunk first
+   SymtabChunk *free_chunks; // chunks freed by exitscope, for reuse
+   SymtabChunk *pinned;      // chunks visible from snapshots
+   SymtabMark *marks;        // marks[d] is where scope d's region begins
+   int maxdepth;             // size of marks
+
+   // Allocate n bytes in the region of the top scope.
+   void *alloc(size_t n)
+   {
+      n = (n + SYMTAB_ALIGN - 1) & ~(SYMTAB_ALIGN - 1);
+      if (chunks == NULL || chunks->used + n > SYMTAB_CHUNK_SIZE) {
+	 SymtabChunk *c = free_chunks;
+	 if (c != NULL)
+	    free_chunks = c->prev;
+	 else
+	    c = new SymtabChunk;
+	 c->prev = chunks;
+	 c->used = 0;
+	 chunks = c;
+      }
+      void *p = chunks->data.bytes + chunks->used;
+      chunks->used += n;
+      return p;
+   }
+
+   // Free everything allocated since mark m was taken.
+   void rewind(SymtabMark m)
+   {
+      while (chunks != m.chunk) {
+	 SymtabChunk *c = chunks;
+	 chunks = c->prev;
+	 c->prev = free_chunks;
+	 free_chunks = c;
+      }
+      if (chunks != NULL)
+	 chunks->used = m.used;
+   }
+
+   // Make room for n scopes in marks; every mark refers to the bottom
+   // of the region stack when `reset' is true.
+   void resize_marks(int n, bool reset)
+   {
+      if (n > maxdepth) {
+	 int newmax = maxdepth ? 2 * maxdepth : 16;
+	 while (newmax < n)
+	    newmax *= 2;
+	 SymtabMark *newmarks = new SymtabMark[newmax];
+	 for (int i = 0; i < depth; i++)
+	    newmarks[i] = marks[i];
+	 delete [] marks;
+	 marks = newmarks;
+	 maxdepth = newmax;
+      }
+      if (reset)
+	 for (int i = 0; i < n; i++) {
+	    marks[i].chunk = NULL;
+	    marks[i].used = 0;
+	 }
+   }
+
+   static void free_chunk_list(SymtabChunk *c)
+   {
+      while (c != NULL) {
+	 SymtabChunk *prev = c->prev;
+	 delete c;
+	 c = prev;
+      }
+   }
+
+   // Rebuild the scopes of t, outermost first, in this (empty) table.
+   void copy_from(const SymbolTable &t)
+   {
+      Scope **scopes = new Scope *[t.depth ? t.depth : 1];
+      int d = t.depth;
+      for (ScopeList *i = t.tbl; i != NULL; i = i->tl())
+	 scopes[--d] = i->hd();
+      for (d = 0; d < t.depth; d++) {
+	 enterscope();
+	 int n = 0;
+	 for (Scope *j = scopes[d]; j != NULL; j = j->tl())
+	    n++;
+	 ScopeEntry **entries = new ScopeEntry *[n ? n : 1];
+	 int k = n;
+	 for (Scope *j = scopes[d]; j != NULL; j = j->tl())
+	    entries[--k] = j->hd();
+	 for (k = 0; k < n; k++)
+	    addid(entries[k]->get_id(), entries[k]->get_info());
+	 delete [] entries;
+      }
+      delete [] scopes;
+   }
+
+   void release()
+   {
+      free_chunk_list(chunks);
+      free_chunk_list(free_chunks);
+      free_chunk_list(pinned);
+      delete [] marks;
+   }
+
+   void init()
+   {
+      tbl = NULL;
+      depth = 0;
+      chunks = free_chunks = pinned = NULL;
+      marks = NULL;
+      maxdepth = 0;
+   }
+
 public:
-   SymbolTable(): tbl(NULL) { }     // create a new symbol table
+   SymbolTable() { init(); }     // create a new symbol table
+   SymbolTable(const SymbolTable &s) { init(); copy_from(s); }
+   ~SymbolTable() { release(); }
 
-   // Create pointer to current symbol table.
-   SymbolTable &operator =(const SymbolTable &s) { tbl = s.tbl; return *this; }
+   // Copy the symbol table.
+   SymbolTable &operator =(const SymbolTable &s)
+   {
+      if (this != &s) {
+	 SymtabMark bottom = { NULL, 0 };
+	 rewind(bottom);
+	 tbl = NULL;
+	 depth = 0;
+	 copy_from(s);
+      }
+      return *this;
+   }
+
+   // Save the current state of the table.
+   Snapshot snapshot()
+   {
+      if (chunks != NULL) {
+	 SymtabChunk *bottom = chunks;
+	 while (bottom->prev != NULL)
+	    bottom = bottom->prev;
+	 bottom->prev = pinned;
+	 pinned = chunks;
+	 chunks = NULL;
+	 resize_marks(depth, true);
+      }
+      Snapshot s;
+      s.scopes = tbl;
+      s.depth = depth;
+      return s;
+   }
+
+   // Return the table to a state saved by `snapshot'.
+   void restore(const Snapshot &s)
+   {
+      SymtabMark bottom = { NULL, 0 };
+      rewind(bottom);
+      resize_marks(s.depth, true);
+      tbl = s.scopes;
+      depth = s.depth;
+   }
 
    void fatal_error(char * msg)
    {
@@ -97,12 +303,16 @@ public:
 
    void enterscope()
    {
+       resize_marks(depth + 1, false);
+       marks[depth].chunk = chunks;
+       marks[depth].used = chunks ? chunks->used : 0;
+       depth++;
        // The cast of NULL is required for template instantiation to work
        // correctly.
-       tbl = new ScopeList((Scope *) NULL, tbl);
+       tbl = new (alloc(sizeof(ScopeList))) ScopeList((Scope *) NULL, tbl);
    }
 
-   // Pop the first scope off of the symbol table.
+   // Pop the first scope off of the symbol table, and free its region.
    void exitscope()
    {
        // It is an error to exit a scope that doesn't exist.
@@ -110,6 +320,7 @@ public:
 	   fatal_error("exitscope: Can't remove scope from an empty symbol table.");
        }
        tbl = tbl->tl();
+       rewind(marks[--depth]);
    }
 
    // Add an item to the symbol table.
@@ -117,8 +328,9 @@ public:
    {
        // There must be at least one scope to add a symbol.
        if (tbl == NULL) fatal_error("addid: Can't add a symbol without a scope.");
-       ScopeEntry * se = new ScopeEntry(s,i);
-       tbl = new ScopeList(new Scope(se, tbl->hd()), tbl->tl());
+       ScopeEntry * se = new (alloc(sizeof(ScopeEntry))) ScopeEntry(s,i);
+       Scope *scope = new (alloc(sizeof(Scope))) Scope(se, tbl->hd());
+       tbl = new (alloc(sizeof(ScopeList))) ScopeList(scope, tbl->tl());
        return(se);
    }
    
@@ -166,5 +378,261 @@ public:
  
 };
 
+//
+// HashedSymbolTable<SYM,DAT> has the same interface as SymbolTable, but
+//    `lookup', `probe', `addid' and `exitscope' take constant time
+//    (amortized) instead of time proportional to the number of visible
+//    symbols.  A class that derives from SymbolTable can derive from
+//    HashedSymbolTable instead without further changes, unless it uses
+//    `snapshot' and `restore'; use `operator =' to save its state.
+//
+//    Every binding made by `addid' is pushed on one stack of bindings.
+//    Each binding remembers the binding it shadows, if any, so the
+//    bindings of one symbol form a shadow stack.  A hash table maps each
+//    symbol to the innermost of its bindings.  The bindings of a scope
+//    are contiguous on the stack, so `exitscope' pops them, restoring
+//    each symbol's shadowed binding as it goes; the start of each scope
+//    is kept in a separate stack of marks.
+//
+//    Bindings are stored in fixed-size blocks that are never moved, so
+//    the entry returned by `addid' stays valid until its scope is
+//    exited.  Blocks are reused after `exitscope' rather than freed.
+//
+//    Symbols are hashed by value, which suits the pointer types (Symbol,
+//    char *) that the compiler uses as keys, and compared with `=='.
+//
+//    `operator =' makes a deep copy, so that, as with SymbolTable, a
+//    saved table is not affected by later changes to the original.
+//
+
+#define SYMTAB_BLOCK_BITS 8
+#define SYMTAB_BLOCK_SIZE (1 << SYMTAB_BLOCK_BITS)
+
+template <class SYM, class DAT>
+class HashedSymbolTable
+{
+   typedef SymtabEntry<SYM,DAT> ScopeEntry;
+
+   // A binding, and the bookkeeping needed to undo it.
+   struct Binding {
+      ScopeEntry entry;
+      int shadowed;     // previous binding of the same symbol, or -1
+      int scope;        // depth of the scope it belongs to
+      Binding(SYM s, DAT *i, int sh, int sc)
+	 : entry(s,i), shadowed(sh), scope(sc) { }
+   };
+private:
+   Binding **blocks;  // the binding stack, in blocks of SYMTAB_BLOCK_SIZE
+   int nblocks;       // number of blocks allocated
+   int top;           // number of bindings on the stack
+   int *marks;        // marks[d] is the stack height when scope d began
+   int depth;         // number of scopes entered
+   int maxdepth;      // size of marks
+   SYM *keys;         // hash table: symbols ...
+   int *heads;        // ... and their innermost bindings; -1 for none,
+                      // -2 for an empty slot
+   int hsize;         // number of slots, 1 << hbits
+   int hbits;
+   int hcount;        // number of symbols in the hash table
+
+   Binding &binding(int b)
+   {
+      return blocks[b >> SYMTAB_BLOCK_BITS][b & (SYMTAB_BLOCK_SIZE - 1)];
+   }
+
+   // Multiply by the golden ratio and take the high bits of the product,
+   // which depend on all of the key's bits.  (The low bits of pointers
+   // are zero, and would leave most slots unused.)
+   static unsigned long long hash(SYM s)
+   {
+      unsigned long long h = 0;
+      memcpy(&h, &s, sizeof(s) < sizeof(h) ? sizeof(s) : sizeof(h));
+      return h * 0x9e3779b97f4a7c15ULL;
+   }
+
+   // Return the slot for s, which is either s's slot or the empty
+   // slot where s belongs.
+   int slot(SYM s)
+   {
+      int mask = hsize - 1;
+      int i = (int) (hash(s) >> (64 - hbits));
+      while (heads[i] != -2 && !(keys[i] == s))
+	 i = (i + 1) & mask;
+      return i;
+   }
+
+   void grow_hash()
+   {
+      SYM *oldkeys = keys;
+      int *oldheads = heads;
+      int oldsize = hsize;
+      hbits = oldsize ? hbits + 1 : 6;
+      hsize = 1 << hbits;
+      keys = new SYM[hsize];
+      heads = new int[hsize];
+      for (int i = 0; i < hsize; i++)
+	 heads[i] = -2;
+      for (int i = 0; i < oldsize; i++)
+	 if (oldheads[i] != -2) {
+	    int j = slot(oldkeys[i]);
+	    keys[j] = oldkeys[i];
+	    heads[j] = oldheads[i];
+	 }
+      delete [] oldkeys;
+      delete [] oldheads;
+   }
+
+   void copy_from(const HashedSymbolTable &t)
+   {
+      nblocks = (t.top + SYMTAB_BLOCK_SIZE - 1) >> SYMTAB_BLOCK_BITS;
+      blocks = new Binding *[nblocks ? nblocks : 1];
+      for (int i = 0; i < nblocks; i++) {
+	 blocks[i] = (Binding *) new char[SYMTAB_BLOCK_SIZE * sizeof(Binding)];
+	 memcpy(blocks[i], t.blocks[i], SYMTAB_BLOCK_SIZE * sizeof(Binding));
+      }
+      top = t.top;
+      depth = t.depth;
+      maxdepth = t.maxdepth;
+      marks = maxdepth ? new int[maxdepth] : (int *) NULL;
+      for (int i = 0; i < depth; i++)
+	 marks[i] = t.marks[i];
+      hsize = t.hsize;
+      hbits = t.hbits;
+      hcount = t.hcount;
+      keys = hsize ? new SYM[hsize] : (SYM *) NULL;
+      heads = hsize ? new int[hsize] : (int *) NULL;
+      for (int i = 0; i < hsize; i++) {
+	 keys[i] = t.keys[i];
+	 heads[i] = t.heads[i];
+      }
+   }
+
+   void release()
+   {
+      for (int i = 0; i < nblocks; i++)
+	 delete [] (char *) blocks[i];
+      delete [] blocks;
+      delete [] marks;
+      delete [] keys;
+      delete [] heads;
+   }
+
+public:
+   HashedSymbolTable(): blocks((Binding **) NULL), nblocks(0), top(0),
+      marks((int *) NULL), depth(0), maxdepth(0),
+      keys((SYM *) NULL), heads((int *) NULL), hsize(0), hbits(0),
+      hcount(0) { }
+   HashedSymbolTable(const HashedSymbolTable &t) { copy_from(t); }
+   ~HashedSymbolTable() { release(); }
+
+   // Copy the symbol table.
+   HashedSymbolTable &operator =(const HashedSymbolTable &t)
+   {
+      if (this != &t) {
+	 release();
+	 copy_from(t);
+      }
+      return *this;
+   }
+
+   void fatal_error(char * msg)
+   {
+     cerr << msg << "\n";
+     exit(1);
+   } 
+
+   // Enter a new scope.
+   void enterscope()
+   {
+      if (depth == maxdepth) {
+	 int *newmarks = new int[maxdepth ? 2 * maxdepth : 16];
+	 for (int i = 0; i < depth; i++)
+	    newmarks[i] = marks[i];
+	 delete [] marks;
+	 marks = newmarks;
+	 maxdepth = maxdepth ? 2 * maxdepth : 16;
+      }
+      marks[depth++] = top;
+   }
+
+   // Pop the innermost scope, unbinding its symbols.
+   void exitscope()
+   {
+      // It is an error to exit a scope that doesn't exist.
+      if (depth == 0) {
+	 fatal_error("exitscope: Can't remove scope from an empty symbol table.");
+      }
+      int mark = marks[--depth];
+      while (top > mark) {
+	 Binding &b = binding(--top);
+	 heads[slot(b.entry.get_id())] = b.shadowed;
+      }
+   }
+
+   // Add an item to the symbol table.
+   ScopeEntry *addid(SYM s, DAT *i)
+   {
+      // There must be at least one scope to add a symbol.
+      if (depth == 0) fatal_error("addid: Can't add a symbol without a scope.");
+      if (2 * (hcount + 1) > hsize)
+	 grow_hash();
+      int h = slot(s);
+      if (heads[h] == -2) {
+	 keys[h] = s;
+	 heads[h] = -1;
+	 hcount++;
+      }
+      if ((top >> SYMTAB_BLOCK_BITS) == nblocks) {
+	 Binding **newblocks = new Binding *[nblocks + 1];
+	 for (int b = 0; b < nblocks; b++)
+	    newblocks[b] = blocks[b];
+	 newblocks[nblocks++] =
+	    (Binding *) new char[SYMTAB_BLOCK_SIZE * sizeof(Binding)];
+	 delete [] blocks;
+	 blocks = newblocks;
+      }
+      Binding *b = new (&binding(top)) Binding(s, i, heads[h], depth - 1);
+      heads[h] = top++;
+      return &b->entry;
+   }
+
+   // Lookup an item through all scopes of the symbol table.  If found
+   // it returns the associated information field, if not it returns
+   // NULL.
+   DAT *lookup(SYM s)
+   {
+      if (hsize == 0)
+	 return NULL;
+      int b = heads[slot(s)];
+      return b >= 0 ? binding(b).entry.get_info() : (DAT *) NULL;
+   }
+
+   // probe the symbol table.  Check the top scope (only) for the item
+   // 's'.  If found, return the information field.  If not return NULL.
+   DAT *probe(SYM s)
+   {
+      if (depth == 0) {
+	 fatal_error("probe: No scope in symbol table.");
+      }
+      if (hsize == 0)
+	 return NULL;
+      int b = heads[slot(s)];
+      if (b >= 0 && binding(b).scope == depth - 1)
+	 return binding(b).entry.get_info();
+      return NULL;
+   }
+
+   // Prints out the contents of the symbol table  
+   void dump()
+   {
+      int b = top;
+      for (int d = depth - 1; d >= 0; d--) {
+	 cerr << "\nScope: \n";
+	 while (b > marks[d])
+	    cerr << "  " << binding(--b).entry.get_id() << endl;
+      }
+   }
+};
+
 #endif
 
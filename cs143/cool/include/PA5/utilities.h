@@ -8,13 +8,47 @@
 #ifndef _UTILITIES_H_
 #define _UTILITIES_H_
 
+#include <stdio.h>
 #include "cool-io.h"
 
 extern char *cool_token_to_string(int tok);
 extern void print_cool_token(int tok);
+union YYSTYPE;
+extern void print_cool_token(ostream& out, int tok, YYSTYPE *lval);
+extern void print_parse_error(ostream& out, char *filename, int lineno,
+			      char *msg, int tok, YYSTYPE *lval);
 extern void fatal_error(char *);
 extern void print_escaped_string(ostream& str, const char *s);
 extern char *pad(int);
+
+/* Binary token streams, selected with the -b flag; see utilities.cc. */
+extern int binary_tokens;
+extern void begin_binary_tokens(FILE *out);
+extern void name_binary_tokens(FILE *out, char *filename);
+extern void dump_binary_token(FILE *out, int lineno, int token);
+extern void end_binary_tokens(FILE *out);
+extern int next_binary_token(FILE *in);
+
+/* Source files mapped in place, with the -m flag; see utilities.cc. */
+extern int mmap_input;
+
+/* The number of files the lexer scans at once, set with -j. */
+extern int lex_threads;
+extern char *map_source_file(char *filename, size_t *len);
+extern void unmap_source_file(char *text, size_t len);
+
+/* The binary AST is written with the -B flag; see ast-binary.cc. */
+extern int binary_ast;
+
+/* The hand-written parser is used with the -P flag; see pratt-parse.cc. */
+extern int pratt_parser;
+
+/* coolc's class cache directory, set with -i; see class-cache.cc. */
+extern char *class_cache;
+
+/* The parser counts what it does, and the parser phase prints a summary,
+   with the -S flag; see parse-context.h. */
+extern int parser_stats;
 /*  On some machines strdup is not in the standard library. */
 //char *strdup(const char *s);
 
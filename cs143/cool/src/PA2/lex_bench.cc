@@ -0,0 +1,339 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  lex_bench.cc
+//
+//  Throughput of the COOL scanner (cool.flex), on synthetic inputs and
+//  on the files given as arguments.
+//
+//  The synthetic inputs are generated in the bench directory, each of
+//  about the given size (default 16MB), with one kind of text
+//  dominating each:
+//
+//      identifiers   long identifiers and keywords
+//      strings       string constants full of escapes
+//      comments      deeply nested comments, and line comments
+//      integers      large integer constants
+//      mixed         mostly identifiers, with some of each of the others
+//
+//  Each input is mapped and scanned in place, as lextest -m does, and
+//  the report gives its size, the number of tokens, MB/s and tokens/s.
+//
+//  The time is also split between flex and the string tables.  The
+//  symbols the scanner interned are added again, in the same order, to
+//  empty tables; this takes the time the scanner spent in add_string
+//  and add_chars, and the rest is flex and the rule actions.
+//
+//  Each input is scanned in its own process, so that every scan starts
+//  with empty string tables, as the lexer does.
+//
+//  With -g the inputs are only generated, and kept, so that they can be
+//  given to the lexer or to this program later.
+//
+//  usage: lex_bench [-s megabytes] [-c corpus] [-d directory] [-g]
+//                   [files...]
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>     // for getopt, fork
+#include <sys/wait.h>
+#include "cool-parse.h"
+#include "cool-lex.h"
+#include "stringtab.h"
+#include "utilities.h"
+
+YYSTYPE cool_yylval;           // Not compiled with parser, so must define this.
+int curr_lineno;
+char *curr_filename = "<bench>";
+FILE *fin;                     // read by cool_yylex, which is not used here
+int cool_lex_debug;            // 0, as handle_flags is not linked: no tracing
+
+extern int optind;  // used for option processing (man 3 getopt for more info)
+extern char *optarg;
+
+static double seconds(clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+//
+// The generators.  Each writes statements of one kind to f until it
+// has written size bytes, in classes of a few hundred statements.
+//
+static long written;
+
+static void emit(FILE *f, const char *fmt, ...)
+  __attribute__ ((format (printf, 2, 3)));
+
+static void emit(FILE *f, const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  written += vfprintf(f, fmt, ap);
+  va_end(ap);
+}
+
+#define NNAMES 2000
+
+static char *names[NNAMES];    // long identifiers, half of them types
+
+static void make_names()
+{
+  for (int i = 0; i < NNAMES; i++) {
+    int len = 16 + rand() % 48;
+    names[i] = new char[len + 1];
+    names[i][0] = (i % 2 ? 'A' : 'a') + rand() % 26;
+    for (int j = 1; j < len; j++) {
+      int c = rand() % 37;
+      names[i][j] = c < 26 ? 'a' + c : c < 36 ? '0' + c - 26 : '_';
+    }
+    names[i][len] = '\0';
+  }
+}
+
+static char *object_name() { return names[2 * (rand() % (NNAMES / 2))]; }
+static char *type_name()   { return names[2 * (rand() % (NNAMES / 2)) + 1]; }
+
+static void gen_identifiers(FILE *f)
+{
+  switch (rand() % 4) {
+  case 0:
+    emit(f, "\t%s : %s <- new %s;\n", object_name(), type_name(), type_name());
+    break;
+  case 1:
+    emit(f, "\tif %s then %s else %s fi;\n",
+	 object_name(), object_name(), object_name());
+    break;
+  case 2:
+    emit(f, "\tlet %s : %s <- %s.%s(%s) in %s;\n", object_name(),
+	 type_name(), object_name(), object_name(), object_name(),
+	 object_name());
+    break;
+  default:
+    emit(f, "\twhile not isvoid %s loop %s <- %s pool;\n",
+	 object_name(), object_name(), object_name());
+  }
+}
+
+static void gen_strings(FILE *f)
+{
+  static const char *escapes[] = {
+    "\\n", "\\t", "\\b", "\\f", "\\\"", "\\\\", "\\\n", "\\q"
+  };
+  emit(f, "\t%s <- \"", object_name());
+  int len = 20 + rand() % 200;
+  for (int i = 0; i < len; i++) {
+    if (rand() % 4 == 0)
+      emit(f, "%s", escapes[rand() % 8]);
+    else
+      emit(f, "%c", 'a' + rand() % 26);
+  }
+  emit(f, "\";\n");
+}
+
+static void gen_comments(FILE *f)
+{
+  int depth = 1 + rand() % 32;
+  if (rand() % 4 == 0) {
+    emit(f, "\t-- %s %s %s\n", object_name(), type_name(), object_name());
+    return;
+  }
+  for (int i = 0; i < depth; i++)
+    emit(f, "(* %s\n", object_name());
+  for (int i = 0; i < depth; i++)
+    emit(f, "  %s * ( *)\n", type_name());
+  emit(f, "\t%s <- %d;\n", object_name(), rand() % 100);
+}
+
+static void gen_integers(FILE *f)
+{
+  emit(f, "\t%s <- ", object_name());
+  for (int i = 0; i < 4; i++) {
+    int len = 10 + rand() % 30;
+    emit(f, "%d", 1 + rand() % 9);
+    for (int j = 1; j < len; j++)
+      emit(f, "%d", rand() % 10);
+    emit(f, "%s", i < 3 ? " + " : ";\n");
+  }
+}
+
+static void gen_mixed(FILE *f)
+{
+  int r = rand() % 16;
+  if (r < 10)
+    gen_identifiers(f);
+  else if (r < 12)
+    gen_strings(f);
+  else if (r < 14)
+    gen_comments(f);
+  else
+    gen_integers(f);
+}
+
+static struct corpus {
+  const char *name;
+  void (*gen)(FILE *);
+} corpora[] = {
+  { "identifiers", gen_identifiers },
+  { "strings", gen_strings },
+  { "comments", gen_comments },
+  { "integers", gen_integers },
+  { "mixed", gen_mixed },
+};
+
+#define NCORPORA ((int) (sizeof(corpora) / sizeof(corpora[0])))
+
+static void generate(corpus *c, char *filename, long size)
+{
+  FILE *f = fopen(filename, "w");
+  if (f == NULL) {
+    cerr << "Could not open " << filename << endl;
+    exit(1);
+  }
+  srand(143);
+  make_names();
+  written = 0;
+  for (int n = 0; written < size; n++) {
+    if (n % 300 == 0)
+      emit(f, "%sclass %s {\n  %s() : Object {{\n",
+	   n ? "  }} };\n\n" : "", type_name(), object_name());
+    c->gen(f);
+  }
+  emit(f, "  }} };\n");
+  fclose(f);
+}
+
+//
+// Scan a file twice: once for the time, and once to collect the symbols
+// the scanner interned, so that they can be interned again on their own.
+//
+static void bench_file(char *filename)
+{
+  char *text;
+  size_t len;
+  int token, ntokens = 0;
+  clock_t start;
+
+  text = map_source_file(filename, &len);
+  if (text == NULL) {
+    cerr << "Could not map input file " << filename << endl;
+    exit(1);
+  }
+  cool_lexer *lx = new_cool_lexer();
+
+  cool_lexer_text(lx, text, len);
+  start = clock();
+  while ((token = cool_lexer_token(lx)) != 0)
+    ntokens++;
+  double total = seconds(start);
+
+  lexed_token *tokens = new lexed_token[ntokens];
+  cool_lexer_text(lx, text, len);
+  for (int i = 0; i < ntokens; i++) {
+    tokens[i].token = cool_lexer_token(lx);
+    tokens[i].lval = lx->lval;
+  }
+
+  IdTable ids;
+  IntTable ints;
+  StrTable strs;
+  start = clock();
+  for (lexed_token *t = tokens; t < tokens + ntokens; t++) {
+    switch (t->token) {
+    case TYPEID:
+    case OBJECTID:
+      ids.add_string(t->lval.symbol->get_string(), t->lval.symbol->get_len());
+      break;
+    case INT_CONST:
+      ints.add_string(t->lval.symbol->get_string(), t->lval.symbol->get_len());
+      break;
+    case STR_CONST:
+      strs.add_chars(t->lval.symbol->get_string(), t->lval.symbol->get_len());
+      break;
+    }
+  }
+  double intern = seconds(start);
+  if (intern > total)
+    intern = total;
+
+  double mb = (len - 2) / 1e6;
+  printf("%-28s %7.1fMB %9d tokens %8.1f MB/s %6.2f Mtokens/s"
+	 "   flex %4.1f%%  add_string %4.1f%%\n",
+	 filename, mb, ntokens,
+	 total > 0 ? mb / total : 0.0,
+	 total > 0 ? ntokens / total / 1e6 : 0.0,
+	 total > 0 ? 100 * (total - intern) / total : 0.0,
+	 total > 0 ? 100 * intern / total : 0.0);
+
+  delete [] tokens;
+  delete_cool_lexer(lx);
+  unmap_source_file(text, len);
+}
+
+// Scan the file in a child process and wait for it.
+static void run_child(char *filename)
+{
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    bench_file(filename);
+    fflush(stdout);
+    exit(0);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  long size = 16;
+  char *only = NULL;
+  char *dir = "/tmp";
+  int generate_only = 0;
+  int c;
+
+  while ((c = getopt(argc, argv, "s:c:d:g")) != -1) {
+    if (c == 's')
+      size = atol(optarg);
+    else if (c == 'c')
+      only = optarg;
+    else if (c == 'd')
+      dir = optarg;
+    else if (c == 'g')
+      generate_only = 1;
+    else {
+      cerr << "usage: " << argv[0] << " [-s megabytes] [-c corpus]"
+	   << " [-d directory] [-g] [files...]\n";
+      exit(1);
+    }
+  }
+
+  for (int i = 0; i < NCORPORA; i++) {
+    if (only != NULL && strcmp(only, corpora[i].name) != 0)
+      continue;
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s/lex_bench_%s.cl",
+	     dir, corpora[i].name);
+    generate(&corpora[i], filename, size * 1000000);
+    if (generate_only) {
+      printf("%s\n", filename);
+      continue;
+    }
+    run_child(filename);
+    unlink(filename);
+  }
+  for (; optind < argc; optind++)
+    run_child(argv[optind]);
+  return 0;
+}
@@ -11,12 +11,21 @@
 //  Reads input from file argument.
 //
 //  Option -l prints summary of flex actions.
+//  Option -b writes a binary token stream (see utilities.cc) for a
+//  parser run with -b, instead of one line of text per token.
+//  Option -m maps each file and scans it in place, instead of reading
+//  it through fin.
+//  Option -j n lexes n files at once, each with its own lexer (see
+//  cool-lex.h), and prints their tokens in command-line order.
 //
 //////////////////////////////////////////////////////////////////////////////
 
 #include <stdio.h>      // needed on Linux system
 #include <unistd.h>     // for getopt
+#include <pthread.h>
 #include "cool-parse.h" // bison-generated file; defines tokens
+#include "cool-lex.h"
+#include "stringtab.h"
 #include "utilities.h"
 
 //
@@ -32,15 +41,16 @@ FILE *fin;   // This is the file pointer from which the lexer reads its input.
 //  token each time it is called.
 //
 extern int cool_yylex();
+extern void scan_mapped_input(char *text, size_t len);
 YYSTYPE cool_yylval;           // Not compiled with parser, so must define this.
 
 extern int optind;  // used for option processing (man 3 getopt for more info)
 
 //
 //  Option -v sets the lex_verbose flag. The main() function prints out tokens
-//  if the program is invoked with option -v.  Option -l sets yy_flex_debug.
+//  if the program is invoked with option -v.  Option -l sets cool_lex_debug.
 //
-extern int yy_flex_debug;      // Flex debugging; see flex documentation.
+extern int cool_lex_debug;     // Flex debugging; see flex documentation.
 extern int lex_verbose;        // Controls printing of tokens.
 void handle_flags(int argc, char *argv[]);
 
@@ -56,17 +66,158 @@ int  cool_yydebug;
 extern void dump_cool_token(ostream& out, int lineno, 
 			    int token, YYSTYPE yylval);
 
+//
+// Parallel lexing (-j).  The files are handed out to lex_threads threads
+// in command-line order; each thread has one lexer and keeps the tokens
+// of each file it lexes.  The string tables are in concurrent mode
+// meanwhile, and are numbered afterwards in an order that does not
+// depend on the threads (see stringtab.h), so the output is the same as
+// for a single thread, except that the string table indices in a
+// binary token stream are numbered differently.
+//
+struct lexed_file {
+	char *name;
+	lexed_token *tokens;
+	int count;
+	int capacity;
+};
+
+static lexed_file *lexed_files;
+static int nfiles;
+static int next_file;              // the next file to hand out
+static pthread_mutex_t next_file_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void add_token(lexed_file *f, int token, int lineno, YYSTYPE lval)
+{
+	if (f->count == f->capacity) {
+	    int capacity = f->capacity ? 2 * f->capacity : 1024;
+	    lexed_token *tokens = new lexed_token[capacity];
+	    for (int i = 0; i < f->count; i++)
+		tokens[i] = f->tokens[i];
+	    delete [] f->tokens;
+	    f->tokens = tokens;
+	    f->capacity = capacity;
+	}
+	lexed_token *t = &f->tokens[f->count++];
+	t->token = token;
+	t->lineno = lineno;
+	t->lval = lval;
+}
+
+static void lex_file(cool_lexer *lx, lexed_file *f)
+{
+	FILE *in = NULL;
+	char *text;
+	size_t len;
+	int token;
+
+	if (mmap_input) {
+	    text = map_source_file(f->name, &len);
+	    if (text == NULL) {
+		cerr << "Could not map input file " << f->name << endl;
+		exit(1);
+	    }
+	    cool_lexer_text(lx, text, len);
+	} else {
+	    in = fopen(f->name, "r");
+	    if (in == NULL) {
+		cerr << "Could not open input file " << f->name << endl;
+		exit(1);
+	    }
+	    cool_lexer_file(lx, in);
+	}
+	while ((token = cool_lexer_token(lx)) != 0)
+	    add_token(f, token, lx->lineno, lx->lval);
+	if (mmap_input)
+	    unmap_source_file(text, len);
+	else
+	    fclose(in);
+}
+
+static void *lex_files(void *)
+{
+	cool_lexer *lx = new_cool_lexer();
+	for (;;) {
+	    pthread_mutex_lock(&next_file_lock);
+	    int i = next_file++;
+	    pthread_mutex_unlock(&next_file_lock);
+	    if (i >= nfiles)
+		break;
+	    lex_file(lx, &lexed_files[i]);
+	}
+	delete_cool_lexer(lx);
+	return NULL;
+}
+
+static void lex_in_parallel(int n, char **names)
+{
+	nfiles = n;
+	lexed_files = new lexed_file[n];
+	for (int i = 0; i < n; i++) {
+	    lexed_files[i].name = names[i];
+	    lexed_files[i].tokens = NULL;
+	    lexed_files[i].count = 0;
+	    lexed_files[i].capacity = 0;
+	}
+
+	begin_concurrent_interning();
+	pthread_t *threads = new pthread_t[lex_threads];
+	for (int i = 0; i < lex_threads; i++)
+	    pthread_create(&threads[i], NULL, lex_files, NULL);
+	for (int i = 0; i < lex_threads; i++)
+	    pthread_join(threads[i], NULL);
+	canonicalize_interning();
+
+	if (binary_tokens)
+	    begin_binary_tokens(stdout);
+	for (int i = 0; i < n; i++) {
+	    lexed_file *f = &lexed_files[i];
+	    if (binary_tokens)
+		name_binary_tokens(stdout, f->name);
+	    else
+		cout << "#name \"" << f->name << "\"" << endl;
+	    for (int j = 0; j < f->count; j++) {
+		lexed_token *t = &f->tokens[j];
+		cool_yylval = t->lval;
+		if (binary_tokens)
+		    dump_binary_token(stdout, t->lineno, t->token);
+		else
+		    dump_cool_token(cout, t->lineno, t->token, cool_yylval);
+	    }
+	}
+	if (binary_tokens)
+	    end_binary_tokens(stdout);
+}
+
 
 int main(int argc, char** argv) {
 	int token;
+	char *text;
+	size_t len;
 	
 	handle_flags(argc,argv);
 
+	if (lex_threads > 1) {
+	    lex_in_parallel(argc - optind, argv + optind);
+	    exit(0);
+	}
+
+	if (binary_tokens)
+	    begin_binary_tokens(stdout);
 	while (optind < argc) {
-	    fin = fopen(argv[optind], "r");
-	    if (fin == NULL) {
-		cerr << "Could not open input file " << argv[optind] << endl;
-		exit(1);
+	    if (mmap_input) {
+		text = map_source_file(argv[optind], &len);
+		if (text == NULL) {
+		    cerr << "Could not map input file " << argv[optind] << endl;
+		    exit(1);
+		}
+		scan_mapped_input(text, len);
+	    } else {
+		fin = fopen(argv[optind], "r");
+		if (fin == NULL) {
+		    cerr << "Could not open input file " << argv[optind] << endl;
+		    exit(1);
+		}
 	    }
 
             // sm: the 'coolc' compiler's file-handling loop resets
@@ -77,13 +228,24 @@ int main(int argc, char** argv) {
 	    //
 	    // Scan and print all tokens.
 	    //
-	    cout << "#name \"" << argv[optind] << "\"" << endl;
-	    while ((token = cool_yylex()) != 0) {
-		dump_cool_token(cout, curr_lineno, token, cool_yylval);
+	    if (binary_tokens) {
+		name_binary_tokens(stdout, argv[optind]);
+		while ((token = cool_yylex()) != 0)
+		    dump_binary_token(stdout, curr_lineno, token);
+	    } else {
+		cout << "#name \"" << argv[optind] << "\"" << endl;
+		while ((token = cool_yylex()) != 0) {
+		    dump_cool_token(cout, curr_lineno, token, cool_yylval);
+		}
 	    }
-	    fclose(fin);
+	    if (mmap_input)
+		unmap_source_file(text, len);
+	    else
+		fclose(fin);
 	    optind++;
 	}
+	if (binary_tokens)
+	    end_binary_tokens(stdout);
 	exit(0);
 }
 
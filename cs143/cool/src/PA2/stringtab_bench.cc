@@ -0,0 +1,202 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  stringtab_bench.cc
+//
+//  Micro-benchmarks for the string tables.
+//
+//  Traversal: fills an IdTable with n distinct identifiers (default
+//  100000) and then visits every entry twice: once with the
+//  first/more/next iterator and lookup(i), and once by walking the
+//  entry list directly.
+//
+//  Allocation: interns the identifiers, integers and strings of each
+//  file argument (e.g. examples/*.cl), and of a synthetic 1M-token
+//  input, and reports the number of heap allocations the tables made.
+//  (Before the entry arena, the tables allocated each Entry, its
+//  characters and its list cell separately: three per symbol.)
+//
+//  usage: stringtab_bench [-n entries] [files...]
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>     // for getopt
+#include "cool-parse.h"
+#include "stringtab.h"
+
+YYSTYPE cool_yylval;           // Not compiled with parser, so must define this.
+int curr_lineno;
+char *curr_filename;
+
+extern int optind;  // used for option processing (man 3 getopt for more info)
+extern char *optarg;
+
+//
+// BenchTable exposes the entry list so both traversals can be timed.
+//
+class BenchTable : public IdTable {
+public:
+  List<IdEntry> *entry_list() { return tbl; }
+};
+
+static double seconds(clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void traversal_bench(int n)
+{
+  BenchTable table;
+  char buf[32];
+  clock_t start;
+  long sum;
+
+  start = clock();
+  for (int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "ident_%d", i);
+    table.add_string(buf);
+  }
+  printf("add_string:       %d entries in %.4fs\n", n, seconds(start));
+
+  // Traversal by index, the way callers of the iterator protocol do it.
+  sum = 0;
+  start = clock();
+  for (int i = table.first(); table.more(i); i = table.next(i))
+    sum += table.lookup(i)->get_len();
+  printf("iterator+lookup:  %.4fs (checksum %ld)\n", seconds(start), sum);
+
+  // Traversal of the underlying list.
+  sum = 0;
+  start = clock();
+  for (List<IdEntry> *l = table.entry_list(); l; l = l->tl())
+    sum += l->hd()->get_len();
+  printf("list walk:        %.4fs (checksum %ld)\n", seconds(start), sum);
+}
+
+//
+// A rough COOL tokenizer: good enough to feed realistic symbols to the
+// tables, without depending on the flex scanner.
+//
+static int intern_tokens(char *p, char *end,
+			 IdTable &ids, IntTable &ints, StrTable &strs)
+{
+  int tokens = 0;
+  while (p < end) {
+    char *start = p;
+    if (isalpha(*p)) {
+      while (p < end && (isalnum(*p) || *p == '_')) p++;
+      ids.add_chars(start, p - start);
+    } else if (isdigit(*p)) {
+      while (p < end && isdigit(*p)) p++;
+      ints.add_chars(start, p - start);
+    } else if (*p == '"') {
+      start = ++p;
+      while (p < end && *p != '"' && *p != '\n') p++;
+      strs.add_chars(start, p - start);
+      p++;
+    } else {
+      if (!isspace(*p)) tokens++;
+      p++;
+      continue;
+    }
+    tokens++;
+  }
+  return tokens;
+}
+
+template <class Elem>
+static int table_size(StringTable<Elem> &table)
+{
+  int n = 0;
+  for (int i = table.first(); table.more(i); i = table.next(i))
+    n++;
+  return n;
+}
+
+static void report(const char *name, int tokens, int symbols, int allocs)
+{
+  printf("%-28s %9d tokens %7d symbols %7d allocs\n",
+	 name, tokens, symbols, allocs);
+}
+
+static void alloc_file(char *filename)
+{
+  FILE *f = fopen(filename, "r");
+  if (f == NULL) {
+    cerr << "Could not open input file " << filename << endl;
+    exit(1);
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char *text = new char[size + 1];
+  size = fread(text, 1, size, f);
+  text[size] = '\0';
+  fclose(f);
+
+  IdTable ids;
+  IntTable ints;
+  StrTable strs;
+  int before = stringtab_allocs;
+  int tokens = intern_tokens(text, text + size, ids, ints, strs);
+  report(filename, tokens,
+	 table_size(ids) + table_size(ints) + table_size(strs),
+	 stringtab_allocs - before);
+  delete [] text;
+}
+
+//
+// The synthetic input is a long sequence of statements over a few
+// thousand names, so most tokens hit existing entries the way they do
+// in real programs.
+//
+static void alloc_synthetic(int ntokens)
+{
+  IdTable ids;
+  IntTable ints;
+  StrTable strs;
+  char buf[64];
+  int before = stringtab_allocs;
+  int tokens = 0;
+
+  srand(143);
+  while (tokens < ntokens) {
+    int len = snprintf(buf, sizeof(buf), "name_%d <- name_%d + %d;",
+		       rand() % 5000, rand() % 5000, rand() % 1000);
+    tokens += intern_tokens(buf, buf + len, ids, ints, strs);
+  }
+  report("synthetic", tokens,
+	 table_size(ids) + table_size(ints) + table_size(strs),
+	 stringtab_allocs - before);
+}
+
+int main(int argc, char *argv[]) {
+  int n = 100000;
+  int c;
+
+  while ((c = getopt(argc, argv, "n:")) != -1) {
+    if (c == 'n')
+      n = atoi(optarg);
+    else {
+      cerr << "usage: " << argv[0] << " [-n entries] [files...]\n";
+      exit(1);
+    }
+  }
+
+  traversal_bench(n);
+  printf("\n");
+  for (; optind < argc; optind++)
+    alloc_file(argv[optind]);
+  alloc_synthetic(1000000);
+  return 0;
+}
@@ -433,6 +433,22 @@ void object_class::dump(ostream& stream, int n)
 }
 
 
+char *ast_node_kind_names[NODE_KINDS] = {
+  "list", "program", "class_", "method", "attr", "formal", "branch",
+  "assign", "static_dispatch", "dispatch", "cond", "loop", "typcase",
+  "block", "let", "plus", "sub", "mul", "divide", "neg", "lt", "eq",
+  "leq", "comp", "int_const", "bool_const", "string_const", "new_",
+  "isvoid", "no_expr", "object"
+};
+
+// count a node in ast_node_counts, if it is set
+static inline void count_node(int kind)
+{
+  if (ast_node_counts != NULL)
+    ast_node_counts[kind]++;
+}
+
+
 // interfaces used by Bison
 Classes nil_Classes()
 {
@@ -511,151 +527,181 @@ Cases append_Cases(Cases p1, Cases p2)
 
 Program program(Classes classes)
 {
+  count_node(NODE_program);
   return new program_class(classes);
 }
 
 Class_ class_(Symbol name, Symbol parent, Features features, Symbol filename)
 {
+  count_node(NODE_class_);
   return new class__class(name, parent, features, filename);
 }
 
 Feature method(Symbol name, Formals formals, Symbol return_type, Expression expr)
 {
+  count_node(NODE_method);
   return new method_class(name, formals, return_type, expr);
 }
 
 Feature attr(Symbol name, Symbol type_decl, Expression init)
 {
+  count_node(NODE_attr);
   return new attr_class(name, type_decl, init);
 }
 
 Formal formal(Symbol name, Symbol type_decl)
 {
+  count_node(NODE_formal);
   return new formal_class(name, type_decl);
 }
 
 Case branch(Symbol name, Symbol type_decl, Expression expr)
 {
+  count_node(NODE_branch);
   return new branch_class(name, type_decl, expr);
 }
 
 Expression assign(Symbol name, Expression expr)
 {
+  count_node(NODE_assign);
   return new assign_class(name, expr);
 }
 
 Expression static_dispatch(Expression expr, Symbol type_name, Symbol name, Expressions actual)
 {
+  count_node(NODE_static_dispatch);
   return new static_dispatch_class(expr, type_name, name, actual);
 }
 
 Expression dispatch(Expression expr, Symbol name, Expressions actual)
 {
+  count_node(NODE_dispatch);
   return new dispatch_class(expr, name, actual);
 }
 
 Expression cond(Expression pred, Expression then_exp, Expression else_exp)
 {
+  count_node(NODE_cond);
   return new cond_class(pred, then_exp, else_exp);
 }
 
 Expression loop(Expression pred, Expression body)
 {
+  count_node(NODE_loop);
   return new loop_class(pred, body);
 }
 
 Expression typcase(Expression expr, Cases cases)
 {
+  count_node(NODE_typcase);
   return new typcase_class(expr, cases);
 }
 
 Expression block(Expressions body)
 {
+  count_node(NODE_block);
   return new block_class(body);
 }
 
 Expression let(Symbol identifier, Symbol type_decl, Expression init, Expression body)
 {
+  count_node(NODE_let);
   return new let_class(identifier, type_decl, init, body);
 }
 
 Expression plus(Expression e1, Expression e2)
 {
+  count_node(NODE_plus);
   return new plus_class(e1, e2);
 }
 
 Expression sub(Expression e1, Expression e2)
 {
+  count_node(NODE_sub);
   return new sub_class(e1, e2);
 }
 
 Expression mul(Expression e1, Expression e2)
 {
+  count_node(NODE_mul);
   return new mul_class(e1, e2);
 }
 
 Expression divide(Expression e1, Expression e2)
 {
+  count_node(NODE_divide);
   return new divide_class(e1, e2);
 }
 
 Expression neg(Expression e1)
 {
+  count_node(NODE_neg);
   return new neg_class(e1);
 }
 
 Expression lt(Expression e1, Expression e2)
 {
+  count_node(NODE_lt);
   return new lt_class(e1, e2);
 }
 
 Expression eq(Expression e1, Expression e2)
 {
+  count_node(NODE_eq);
   return new eq_class(e1, e2);
 }
 
 Expression leq(Expression e1, Expression e2)
 {
+  count_node(NODE_leq);
   return new leq_class(e1, e2);
 }
 
 Expression comp(Expression e1)
 {
+  count_node(NODE_comp);
   return new comp_class(e1);
 }
 
 Expression int_const(Symbol token)
 {
+  count_node(NODE_int_const);
   return new int_const_class(token);
 }
 
 Expression bool_const(Boolean val)
 {
+  count_node(NODE_bool_const);
   return new bool_const_class(val);
 }
 
 Expression string_const(Symbol token)
 {
+  count_node(NODE_string_const);
   return new string_const_class(token);
 }
 
 Expression new_(Symbol type_name)
 {
+  count_node(NODE_new_);
   return new new__class(type_name);
 }
 
 Expression isvoid(Expression e1)
 {
+  count_node(NODE_isvoid);
   return new isvoid_class(e1);
 }
 
 Expression no_expr()
 {
+  count_node(NODE_no_expr);
   return new no_expr_class();
 }
 
 Expression object(Symbol name)
 {
+  count_node(NODE_object);
   return new object_class(name);
 }
 
@@ -0,0 +1,576 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  parse_bench.cc
+//
+//  Times the bison parser (cool.y) against the hand-written one
+//  (pratt-parse.cc), on a generated program of about n tokens (default
+//  2000000) and on the token streams given as arguments, as the lexer
+//  writes them.
+//
+//  The generated program is written as a token stream in the bench
+//  directory, and read like the others.  Its classes, features and
+//  expressions are random, with every kind of expression nested a few
+//  deep.  With -e r, one token in r is replaced by a random one, to
+//  compare the parsers' error recovery instead; the parse then stops
+//  after MAX_PARSE_ERRORS errors.  Junk that opens many blocks can nest
+//  MAX_PARSE_DEPTH deep, and both parsers then stop with "memory
+//  exhausted", though not always at the same token (see pratt-parse.cc);
+//  the two are then reported as different.  With -g the stream is only generated,
+//  and kept, so that it can be given to the parser or to this program
+//  later.
+//
+//  Each stream is read into memory first, so that only the parse is
+//  timed, and then parsed by each parser in a process of its own, from
+//  the same string tables.  The report gives the size of the stream, and
+//  the time and Mtokens/s of each parser.  It also checks that the two
+//  reported the same errors and built the same tree, written as the
+//  binary AST, string tables and all.
+//
+//  usage: parse_bench [-n tokens] [-e rate] [-d directory] [-g] [files...]
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>     // for getopt, fork
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sstream>
+#include "cool-io.h"
+#include "cool-tree.h"
+#include "stringtab.h"
+#include "utilities.h"
+#include "parse-context.h"
+
+char *curr_filename = "<bench>";
+FILE *token_file;              // read by the text token scanner
+
+extern int cool_yylex();
+extern int yy_flex_debug;      // the text token scanner traces by default
+extern void dump_cool_token(ostream& out, int lineno,
+			    int token, YYSTYPE yylval);
+
+extern int optind;  // used for option processing (man 3 getopt for more info)
+extern char *optarg;
+
+static double seconds(clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+struct bench_token {
+  int token;
+  int lineno;
+  YYSTYPE lval;
+};
+
+static bench_token *tokens;    // the tokens of a stream, ending in 0
+static int ntokens;
+static int tokens_size;
+
+static void add_token(int token, int lineno, YYSTYPE lval)
+{
+  if (ntokens == tokens_size) {
+    tokens_size = tokens_size ? 2 * tokens_size : 1 << 16;
+    bench_token *t = new bench_token[tokens_size];
+    memcpy(t, tokens, ntokens * sizeof(bench_token));
+    delete [] tokens;
+    tokens = t;
+  }
+  tokens[ntokens].token = token;
+  tokens[ntokens].lineno = lineno;
+  tokens[ntokens].lval = lval;
+  ntokens++;
+}
+
+//
+// The generator.  Expressions nest up to MAX_DEPTH deep, and each
+// operand of an operator is one that binds tighter than any operator,
+// so that every program generated is free of syntax errors.
+//
+#define MAX_DEPTH 4
+#define NNAMES 1000
+
+static Symbol objects[NNAMES], types[NNAMES / 10];
+static Symbol ints[NNAMES], strings[NNAMES / 10];
+static int gen_lineno;
+
+static void gen(int token)
+{
+  YYSTYPE lval;
+  lval.symbol = NULL;
+  add_token(token, gen_lineno, lval);
+  if (token == ';')
+    gen_lineno++;
+}
+
+static void gen(int token, Symbol sym)
+{
+  YYSTYPE lval;
+  lval.symbol = sym;
+  add_token(token, gen_lineno, lval);
+}
+
+static void gen_object() { gen(OBJECTID, objects[rand() % NNAMES]); }
+static void gen_type()   { gen(TYPEID, types[rand() % (NNAMES / 10)]); }
+
+static void make_names()
+{
+  char buf[32];
+  for (int i = 0; i < NNAMES; i++) {
+    snprintf(buf, sizeof(buf), "name_%d", i);
+    objects[i] = idtable.add_string(buf);
+    snprintf(buf, sizeof(buf), "%d", i * 7919 % 100003);
+    ints[i] = inttable.add_string(buf);
+  }
+  for (int i = 0; i < NNAMES / 10; i++) {
+    snprintf(buf, sizeof(buf), "Type_%d", i);
+    types[i] = idtable.add_string(buf);
+    snprintf(buf, sizeof(buf), "string %d\n", i);
+    strings[i] = stringtable.add_string(buf);
+  }
+}
+
+static void gen_expr(int depth);
+
+static void gen_args(int depth)
+{
+  gen('(');
+  for (int i = rand() % 4; i > 0; i--) {
+    gen_expr(depth + 1);
+    if (i > 1)
+      gen(',');
+  }
+  gen(')');
+}
+
+static void gen_operand(int depth)
+{
+  YYSTYPE lval;
+
+  switch (depth >= MAX_DEPTH ? rand() % 3 : rand() % 10) {
+  case 0:
+    gen_object();
+    break;
+  case 1:
+    gen(INT_CONST, ints[rand() % NNAMES]);
+    break;
+  case 2:
+    if (rand() % 2) {
+      gen(STR_CONST, strings[rand() % (NNAMES / 10)]);
+    } else {
+      lval.boolean = rand() % 2;
+      add_token(BOOL_CONST, gen_lineno, lval);
+    }
+    break;
+  case 3:
+    gen('(');
+    gen_expr(depth + 1);
+    gen(')');
+    break;
+  case 4:
+    gen_object();
+    gen_args(depth);
+    break;
+  case 5:
+    gen_operand(depth + 1);
+    gen('.');
+    gen_object();
+    gen_args(depth);
+    break;
+  case 6:
+    gen_operand(depth + 1);
+    gen('@');
+    gen_type();
+    gen('.');
+    gen_object();
+    gen_args(depth);
+    break;
+  case 7:
+    gen('~');
+    gen_operand(depth + 1);
+    break;
+  case 8:
+    gen(ISVOID);
+    gen_operand(depth + 1);
+    break;
+  default:
+    gen(NEW);
+    gen_type();
+  }
+}
+
+static void gen_expr(int depth)
+{
+  static const int ops[] = { '+', '-', '*', '/' };
+  static const int compares[] = { '<', LE, '=' };
+
+  switch (depth >= MAX_DEPTH ? 0 : rand() % 12) {
+  case 0:
+  case 1:
+  case 2:
+  case 3:
+    gen_operand(depth + 1);
+    for (int i = rand() % 4; i > 0; i--) {
+      gen(ops[rand() % 4]);
+      gen_operand(depth + 1);
+    }
+    if (rand() % 4 == 0) {
+      gen(compares[rand() % 3]);
+      gen_operand(depth + 1);
+    }
+    break;
+  case 4:
+    gen_object();
+    gen(ASSIGN);
+    gen_expr(depth + 1);
+    break;
+  case 5:
+    gen(NOT);
+    gen_expr(depth + 1);
+    break;
+  case 6:
+    gen(IF);
+    gen_expr(depth + 1);
+    gen(THEN);
+    gen_expr(depth + 1);
+    gen(ELSE);
+    gen_expr(depth + 1);
+    gen(FI);
+    break;
+  case 7:
+    gen(WHILE);
+    gen_expr(depth + 1);
+    gen(LOOP);
+    gen_expr(depth + 1);
+    gen(POOL);
+    break;
+  case 8:
+    gen('{');
+    for (int i = 1 + rand() % 4; i > 0; i--) {
+      gen_expr(depth + 1);
+      gen(';');
+    }
+    gen('}');
+    break;
+  case 9:
+    gen(LET);
+    for (int i = 1 + rand() % 3; i > 0; i--) {
+      gen_object();
+      gen(':');
+      gen_type();
+      if (rand() % 2) {
+	gen(ASSIGN);
+	gen_expr(depth + 1);
+      }
+      gen(i > 1 ? ',' : IN);
+    }
+    gen_expr(depth + 1);
+    break;
+  case 10:
+    gen(CASE);
+    gen_expr(depth + 1);
+    gen(OF);
+    for (int i = 1 + rand() % 3; i > 0; i--) {
+      gen_object();
+      gen(':');
+      gen_type();
+      gen(DARROW);
+      gen_expr(depth + 1);
+      gen(';');
+    }
+    gen(ESAC);
+    break;
+  default:
+    gen_operand(depth + 1);
+  }
+}
+
+static void gen_feature()
+{
+  gen_object();
+  if (rand() % 3 == 0) {
+    gen(':');
+    gen_type();
+    if (rand() % 2) {
+      gen(ASSIGN);
+      gen_expr(1);
+    }
+    gen(';');
+    return;
+  }
+  gen('(');
+  for (int i = rand() % 4; i > 0; i--) {
+    gen_object();
+    gen(':');
+    gen_type();
+    if (i > 1)
+      gen(',');
+  }
+  gen(')');
+  gen(':');
+  gen_type();
+  gen('{');
+  gen_expr(0);
+  gen('}');
+  gen(';');
+}
+
+static void generate(char *filename, int n, int error_rate)
+{
+  ofstream out(filename);
+  if (!out) {
+    cerr << "Could not open " << filename << endl;
+    exit(1);
+  }
+  srand(143);
+  make_names();
+  gen_lineno = 1;
+  while (ntokens < n) {
+    gen(CLASS);
+    gen_type();
+    if (rand() % 2) {
+      gen(INHERITS);
+      gen_type();
+    }
+    gen('{');
+    for (int i = 1 + rand() % 20; i > 0; i--)
+      gen_feature();
+    gen('}');
+    gen(';');
+  }
+
+  if (error_rate > 0) {
+    static const int junk[] = { CLASS, IN, FI, OF, ';', ',', '}', ')',
+				'(', '{', ':', ASSIGN, DARROW, '<', '.' };
+    for (int i = rand() % error_rate; i < ntokens; i += 1 + rand() % error_rate)
+      tokens[i].token = junk[rand() % (sizeof(junk) / sizeof(junk[0]))];
+  }
+
+  out << "#name \"parse_bench.cl\"" << endl;
+  for (int i = 0; i < ntokens; i++) {
+    cool_yylval = tokens[i].lval;
+    dump_cool_token(out, tokens[i].lineno, tokens[i].token, cool_yylval);
+  }
+  out.close();
+  delete [] tokens;
+  tokens = NULL;
+  ntokens = tokens_size = 0;
+}
+
+//
+// The parse of a stream, from the tokens in memory.
+//
+static int replay(parse_context *ctx, YYSTYPE *lval, int *lineno)
+{
+  bench_token **next = (bench_token **) ctx->data;
+  bench_token *t = *next;
+  if (t->token != 0)
+    (*next)++;
+  *lval = t->lval;
+  *lineno = t->lineno;
+  return t->token;
+}
+
+static std::ostringstream errors;
+
+static void keep_error(parse_context *ctx, char *msg)
+{
+  print_parse_error(errors, ctx->filename, ctx->lineno, msg,
+		    ctx->token, &ctx->lval);
+}
+
+static struct parser {
+  const char *name;
+  int (*parse)(parse_context *ctx);
+} parsers[] = {
+  { "bison", cool_yyparse },
+  { "pratt", pratt_parse },
+};
+
+#define NPARSERS ((int) (sizeof(parsers) / sizeof(parsers[0])))
+
+static double *times;          // shared with the children, by parser
+
+//
+// Parse the tokens, and write the errors, and the tree if there were
+// none, to result.
+//
+static void parse_tokens(parser *p, double *time, char *result)
+{
+  parse_context ctx;
+  bench_token *next = tokens;
+
+  init_parse_context(&ctx, curr_filename, replay, &next);
+  ctx.report_error = keep_error;
+  clock_t start = clock();
+  p->parse(&ctx);
+  *time = seconds(start);
+  printf("  %-6s %7.3fs %7.2f Mtokens/s %4d errors\n", p->name, *time,
+	 *time > 0 ? ntokens / *time / 1e6 : 0.0, ctx.errors);
+
+  FILE *f = fopen(result, "w");
+  if (f == NULL) {
+    cerr << "Could not open " << result << endl;
+    exit(1);
+  }
+  fputs(errors.str().c_str(), f);
+  if (ctx.errors == 0)
+    ctx.program->write_binary(f);
+  fclose(f);
+}
+
+static int same_file(char *a, char *b)
+{
+  FILE *fa = fopen(a, "r"), *fb = fopen(b, "r");
+  int same = fa != NULL && fb != NULL;
+  char bufa[65536], bufb[65536];
+
+  while (same) {
+    size_t na = fread(bufa, 1, sizeof(bufa), fa);
+    size_t nb = fread(bufb, 1, sizeof(bufb), fb);
+    same = na == nb && memcmp(bufa, bufb, na) == 0;
+    if (na == 0)
+      break;
+  }
+  if (fa != NULL)
+    fclose(fa);
+  if (fb != NULL)
+    fclose(fb);
+  return same;
+}
+
+// Run each parser on the tokens in a child process, and wait for it.
+static void run_parsers(char *dir)
+{
+  char results[NPARSERS][1024];
+
+  for (int i = 0; i < NPARSERS; i++) {
+    snprintf(results[i], sizeof(results[i]), "%s/parse_bench.%s",
+	     dir, parsers[i].name);
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+      parse_tokens(&parsers[i], &times[i], results[i]);
+      fflush(stdout);
+      exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      exit(1);
+  }
+
+  int same = 1;
+  for (int i = 1; i < NPARSERS; i++)
+    same = same && same_file(results[0], results[i]);
+  for (int i = 0; i < NPARSERS; i++)
+    unlink(results[i]);
+  printf("  %s is %.2fx as fast; %s\n", parsers[1].name,
+	 times[1] > 0 ? times[0] / times[1] : 0.0,
+	 same ? "same errors and tree" : "ERRORS OR TREES DIFFER");
+  if (!same)
+    exit(1);
+}
+
+// Read a token stream into memory, and time the parsers on it.
+static void bench_file(char *filename, char *dir)
+{
+  struct stat st;
+  int token;
+
+  token_file = fopen(filename, "r");
+  if (token_file == NULL || fstat(fileno(token_file), &st) < 0) {
+    cerr << "Could not open " << filename << endl;
+    exit(1);
+  }
+  yy_flex_debug = 0;
+  while ((token = cool_yylex()) != 0)
+    add_token(token, curr_lineno, cool_yylval);
+  add_token(0, curr_lineno, cool_yylval);
+  ntokens--;
+  fclose(token_file);
+
+  printf("%-28s %7.1fMB %9d tokens\n", filename, st.st_size / 1e6, ntokens);
+  run_parsers(dir);
+}
+
+// Read and parse the stream in a child process, and wait for it.
+static void run_child(char *filename, char *dir)
+{
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    bench_file(filename, dir);
+    fflush(stdout);
+    exit(0);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  int n = 2000000;
+  int error_rate = 0;
+  char *dir = "/tmp";
+  int generate_only = 0;
+  int c;
+
+  while ((c = getopt(argc, argv, "n:e:d:g")) != -1) {
+    if (c == 'n')
+      n = atoi(optarg);
+    else if (c == 'e')
+      error_rate = atoi(optarg);
+    else if (c == 'd')
+      dir = optarg;
+    else if (c == 'g')
+      generate_only = 1;
+    else {
+      cerr << "usage: " << argv[0] << " [-n tokens] [-e rate]"
+	   << " [-d directory] [-g] [files...]\n";
+      exit(1);
+    }
+  }
+
+  times = (double *) mmap(NULL, NPARSERS * sizeof(double),
+			  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+			  -1, 0);
+  if (times == MAP_FAILED) {
+    cerr << "Could not map the shared times\n";
+    exit(1);
+  }
+
+  if (n > 0) {
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s/parse_bench.tok", dir);
+    pid_t pid = fork();
+    if (pid == 0) {
+      generate(filename, n, error_rate);
+      exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      exit(1);
+    if (generate_only)
+      printf("%s\n", filename);
+    else {
+      run_child(filename, dir);
+      unlink(filename);
+    }
+  }
+  for (; optind < argc; optind++)
+    run_child(argv[optind], dir);
+  return 0;
+}
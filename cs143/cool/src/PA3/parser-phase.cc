@@ -10,14 +10,23 @@
 //
 //  Reads a COOL token stream from a file and builds the abstract syntax tree.
 //
+//  With -S, it also prints on cerr what the parse took: the tokens read,
+//  the deepest the parser nested, the tree nodes it made by kind and the
+//  bytes they take, and the wall time; and with the bison parser, how
+//  often it reduced by each rule of cool.y.  Unusual inputs stand out in
+//  these, as do changes to the parser that make it do more.
+//
 //////////////////////////////////////////////////////////////////////////////
 
 #include <stdio.h>     // for Linux system
+#include <string.h>    // for memset
 #include <unistd.h>    // for getopt
+#include <sys/time.h>  // for gettimeofday
 #include "cool-io.h"  //includes iostream
 #include "cool-tree.h"
 #include "utilities.h"  // for fatal_error
 #include "cool-parse.h"
+#include "parse-context.h"
 
 //
 // These globals keep everything working.
@@ -30,18 +39,89 @@ extern Program ast_root;	 // the AST produced by the parse
 char *curr_filename = "<stdin>";
 
 extern int omerrs;             // a count of lex and parse errors
+extern int yy_flex_debug;      // for the token scanner
+extern int cool_lex_debug;     //   set by -l
 
-extern int cool_yyparse();
 void handle_flags(int argc, char *argv[]);
 
+static double wall_clock()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+//
+// Parse as cool_yyparse() does, counting in cool_yyparse_stats the tree
+// nodes made, the bytes of the arena they came from, and the time.
+//
+static void parse_with_stats()
+{
+    parse_stats *stats = &cool_yyparse_stats;
+
+    memset(stats, 0, sizeof(*stats));
+    ast_node_counts = stats->nodes;
+    int bytes = current_ast_arena->size();
+    double start = wall_clock();
+    cool_yyparse();
+    stats->seconds = wall_clock() - start;
+    stats->bytes = current_ast_arena->size() - bytes;
+    ast_node_counts = NULL;
+}
+
+static void print_stats(parse_stats *stats)
+{
+    int nodes = 0;
+    for (int i = 0; i < NODE_KINDS; i++)
+	nodes += stats->nodes[i];
+
+    fprintf(stderr, "parse statistics for %s (%s parser)\n",
+	    curr_filename, pratt_parser ? "hand-written" : "bison");
+    fprintf(stderr, "  %-22s %10d\n", "tokens", stats->tokens);
+    fprintf(stderr, "  %-22s %10d\n", "max depth", stats->max_depth);
+    fprintf(stderr, "  %-22s %10d\n", "tree nodes", nodes);
+    fprintf(stderr, "  %-22s %10d  (%.1f per node)\n", "tree bytes",
+	    stats->bytes, nodes > 0 ? (double) stats->bytes / nodes : 0.0);
+    fprintf(stderr, "  %-22s %10.3fs (%.2f Mtokens/s)\n", "wall time",
+	    stats->seconds,
+	    stats->seconds > 0 ? stats->tokens / stats->seconds / 1e6 : 0.0);
+
+    fprintf(stderr, "nodes by kind\n");
+    for (int i = 0; i < NODE_KINDS; i++)
+	if (stats->nodes[i] != 0)
+	    fprintf(stderr, "  %-22s %10d %5.1f%%\n", ast_node_kind_names[i],
+		    stats->nodes[i], 100.0 * stats->nodes[i] / nodes);
+
+    if (pratt_parser)
+	return;
+    int reductions = 0;
+    for (int i = 0; i < MAX_PARSE_RULES; i++)
+	reductions += stats->reductions[i];
+    fprintf(stderr, "reductions by rule (%d in all)\n", reductions);
+    char *lhs, *rhs;
+    for (int i = 1; describe_parse_rule(i, &lhs, &rhs); i++)
+	if (stats->reductions[i] != 0)
+	    fprintf(stderr, "  %3d %10d %5.1f%%  %s: %s\n", i,
+		    stats->reductions[i], 100.0 * stats->reductions[i] /
+		    reductions, lhs, rhs);
+}
+
 int main(int argc, char *argv[]) {
     handle_flags(argc, argv);
-    cool_yyparse();
+    yy_flex_debug = cool_lex_debug;
+    if (parser_stats) {
+	parse_with_stats();
+	print_stats(&cool_yyparse_stats);
+    } else
+	cool_yyparse();
     if (omerrs != 0) {
 	cerr << "Compilation halted due to lex and parse errors\n";
 	exit(1);
     }
-    ast_root->dump_with_types(cout,0);
+    if (binary_ast)
+	ast_root->write_binary(stdout);
+    else
+	ast_root->dump_with_types(cout,0);
     return 0;
 }
 
@@ -0,0 +1,216 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  token_bench.cc
+//
+//  Compares the text and binary token streams between the lexer and the
+//  parser.  Writes a generated stream of n tokens (default 2000000) in
+//  both formats, then reads each one back with cool_yylex, as the parser
+//  does, and reports its size and the time taken to write and read it.
+//
+//  Each step runs in its own process, so that every reader starts with
+//  empty string tables, as the parser does.
+//
+//  usage: token_bench [-n tokens] [-d directory]
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>     // for getopt, fork
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "cool-io.h"
+#include "cool-parse.h"
+#include "stringtab.h"
+#include "utilities.h"
+
+YYSTYPE cool_yylval;           // Not compiled with parser, so must define this.
+int cool_yydebug;
+int curr_lineno;
+char *curr_filename = "<bench>";
+FILE *token_file;              // read by the text token scanner
+
+extern int cool_yylex();
+extern int yy_flex_debug;      // the text token scanner traces by default
+extern void dump_cool_token(ostream& out, int lineno,
+			    int token, YYSTYPE yylval);
+
+extern int optind;  // used for option processing (man 3 getopt for more info)
+extern char *optarg;
+
+static double seconds(clock_t start)
+{
+  return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+//
+// The generated program is a long run of statements over a few thousand
+// names, with the mix of symbols, keywords and punctuation of real code.
+//
+static int next_token(int i)
+{
+  char buf[32];
+
+  switch (i % 8) {
+  case 0:
+  case 2:
+    snprintf(buf, sizeof(buf), "name_%d", rand() % 5000);
+    cool_yylval.symbol = idtable.add_string(buf);
+    return OBJECTID;
+  case 1:
+    return ASSIGN;
+  case 3:
+    return '+';
+  case 4:
+    snprintf(buf, sizeof(buf), "%d", rand() % 1000);
+    cool_yylval.symbol = inttable.add_string(buf);
+    return INT_CONST;
+  case 5:
+    if (rand() % 4 == 0) {
+      snprintf(buf, sizeof(buf), "string %d\n", rand() % 500);
+      cool_yylval.symbol = stringtable.add_string(buf);
+      return STR_CONST;
+    }
+    snprintf(buf, sizeof(buf), "Type_%d", rand() % 200);
+    cool_yylval.symbol = idtable.add_string(buf);
+    return TYPEID;
+  case 6:
+    return ';';
+  default:
+    return (rand() % 2) ? LET : IN;
+  }
+}
+
+static void write_streams(int n, char *text, char *binary)
+{
+  ofstream out(text);
+  FILE *f = fopen(binary, "w");
+  if (!out || f == NULL) {
+    cerr << "Could not open output files in the bench directory\n";
+    exit(1);
+  }
+
+  // Generate the tokens first, so that only the writing is timed.
+  int *tokens = new int[n];
+  YYSTYPE *values = new YYSTYPE[n];
+  srand(143);
+  for (int i = 0; i < n; i++) {
+    tokens[i] = next_token(i);
+    values[i] = cool_yylval;
+  }
+
+  clock_t start = clock();
+  out << "#name \"bench.cl\"" << endl;
+  for (int i = 0; i < n; i++) {
+    cool_yylval = values[i];
+    dump_cool_token(out, i / 10 + 1, tokens[i], cool_yylval);
+  }
+  out.close();
+  printf("write text:    %.3fs\n", seconds(start));
+
+  start = clock();
+  begin_binary_tokens(f);
+  name_binary_tokens(f, "bench.cl");
+  for (int i = 0; i < n; i++) {
+    cool_yylval = values[i];
+    dump_binary_token(f, i / 10 + 1, tokens[i]);
+  }
+  end_binary_tokens(f);
+  fclose(f);
+  printf("write binary:  %.3fs\n", seconds(start));
+}
+
+static void read_stream(char *name, char *filename, int binary)
+{
+  struct stat st;
+  int n = 0;
+  long check = 0;
+
+  token_file = fopen(filename, "r");
+  if (token_file == NULL || fstat(fileno(token_file), &st) < 0) {
+    cerr << "Could not open " << filename << endl;
+    exit(1);
+  }
+  binary_tokens = binary;
+  yy_flex_debug = 0;
+
+  clock_t start = clock();
+  int token;
+  while ((token = cool_yylex()) != 0) {
+    n++;
+    check += curr_lineno;
+  }
+  double t = seconds(start);
+  printf("read %-8s  %.3fs  %9ld bytes  %5.2f bytes/token  %6.2f Mtokens/s"
+	 " (%d tokens, checksum %ld)\n",
+	 name, t, (long) st.st_size, (double) st.st_size / n,
+	 t > 0 ? n / t / 1e6 : 0.0, n, check);
+}
+
+// Run f in a child process and wait for it.
+static void run_child(void (*f)(int, char *, char *), int n,
+		      char *text, char *binary)
+{
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    f(n, text, binary);
+    fflush(stdout);
+    exit(0);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    exit(1);
+}
+
+static void write_step(int n, char *text, char *binary)
+{
+  write_streams(n, text, binary);
+}
+
+static void read_text_step(int, char *text, char *)
+{
+  read_stream("text:", text, 0);
+}
+
+static void read_binary_step(int, char *, char *binary)
+{
+  read_stream("binary:", binary, 1);
+}
+
+int main(int argc, char *argv[]) {
+  int n = 2000000;
+  char *dir = "/tmp";
+  int c;
+
+  while ((c = getopt(argc, argv, "n:d:")) != -1) {
+    if (c == 'n')
+      n = atoi(optarg);
+    else if (c == 'd')
+      dir = optarg;
+    else {
+      cerr << "usage: " << argv[0] << " [-n tokens] [-d directory]\n";
+      exit(1);
+    }
+  }
+
+  char text[1024], binary[1024];
+  snprintf(text, sizeof(text), "%s/token_bench.txt", dir);
+  snprintf(binary, sizeof(binary), "%s/token_bench.bin", dir);
+
+  printf("%d tokens\n", n);
+  run_child(write_step, n, text, binary);
+  run_child(read_text_step, n, text, binary);
+  run_child(read_binary_step, n, text, binary);
+  unlink(text);
+  unlink(binary);
+  return 0;
+}
@@ -699,9 +699,11 @@ char *yytext;
 #include "stringtab.h"
 #include "utilities.h"
 
-/* The compiler assumes these identifiers. */
+/* The compiler assumes these identifiers.  The parser calls cool_yylex,
+ * below, which reads a binary token stream when the -b flag is given and
+ * uses this scanner otherwise. */
 #define yylval cool_yylval
-#define yylex  cool_yylex
+#define yylex  text_yylex
 
 /* Max size of string constants */
 #define MAX_STR_CONST 1025
@@ -728,6 +730,15 @@ extern char* curr_filename;
 
 static int prevstate;
 
+int text_yylex();
+
+int cool_yylex()
+{
+  if (binary_tokens)
+    return next_binary_token(token_file);
+  return text_yylex();
+}
+
 
 #line 733 "tokens-lex.cc"
 
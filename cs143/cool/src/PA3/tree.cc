@@ -15,8 +15,67 @@
 
 #include "tree.h"
 
-/* line number to assign to the current node being constructed */
-int node_lineno = 1;
+/* line number to assign to the current node being constructed; each
+   thread builds its own nodes, so each has its own */
+__thread int node_lineno = 1;
+
+/* the arena that tree nodes are allocated from */
+ast_arena default_ast_arena;
+__thread ast_arena *current_ast_arena = &default_ast_arena;
+
+/* where new nodes are counted, by kind, if anywhere */
+__thread int *ast_node_counts = NULL;
+
+///////////////////////////////////////////////////////////////////////////
+//
+// ast_arena::new_chunk
+//
+// start a fresh chunk large enough for a request of size bytes; whatever
+// is left of the old chunk is abandoned.  Each chunk begins with a link
+// to the previous one.
+//
+///////////////////////////////////////////////////////////////////////////
+void ast_arena::new_chunk(int size)
+{
+    int chunk = size > AST_ARENA_CHUNK_SIZE ? size : AST_ARENA_CHUNK_SIZE;
+    char *c = new char[AST_ARENA_ROUND(sizeof(char *)) + chunk];
+    *(char **) c = chunks;
+    chunks = c;
+    next = c + AST_ARENA_ROUND(sizeof(char *));
+    limit = next + chunk;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//
+// ast_arena::release
+//
+// free every chunk of the arena, and with them all of its nodes
+//
+///////////////////////////////////////////////////////////////////////////
+void ast_arena::release()
+{
+    while (chunks != NULL) {
+	char *prev = *(char **) chunks;
+	delete [] chunks;
+	chunks = prev;
+    }
+    next = limit = NULL;
+    nbytes = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//
+// set_ast_arena
+//
+// make a the arena for new tree nodes; returns the previous arena
+//
+///////////////////////////////////////////////////////////////////////////
+ast_arena *set_ast_arena(ast_arena *a)
+{
+    ast_arena *old = current_ast_arena;
+    current_ast_arena = a;
+    return old;
+}
 
 ///////////////////////////////////////////////////////////////////////////
 //
@@ -0,0 +1,66 @@
+#!/bin/sh
+#
+# cache_test.sh file.cl ...
+#
+# Checks coolc -i (see class-cache.cc) against a full parse of the same
+# files: first with an empty cache, then with the entries that compile
+# saved, and then with each entry damaged, in turn, at each of its
+# bytes and cut short at each of its lengths.  A damaged entry must be
+# parsed again from the class's text: it must not change the tree, nor
+# make coolc fail or hang.  `make cache_test' runs it on good.cl; it
+# prints each failed check and exits with status 1 if there were any.
+#
+
+dir=cache_test.dir
+failures=0
+
+fail()
+{
+    echo "cache_test: failed: $*"
+    failures=`expr $failures + 1`
+}
+
+# compile with the cache, and compare the tree with the full parse's
+check()
+{
+    if timeout 10 ./coolc -i $dir "$@" >cache_test.out 2>&1 &&
+       cmp -s cache_test.full cache_test.out; then
+	:
+    else
+	fail "$what"
+    fi
+}
+
+rm -rf $dir
+./coolc "$@" >cache_test.full 2>&1 || fail "full parse of $*"
+
+what="empty cache"; check "$@"
+what="saved cache"; check "$@"
+
+for entry in $dir/*; do
+    cp $entry cache_test.entry
+    size=`wc -c <cache_test.entry`
+    i=0
+    while [ $i -lt $size ]; do
+	# a huge varint, as a list count, line number or symbol
+	cp cache_test.entry $entry
+	printf '\377\377\377\377\017' |
+	    dd of=$entry bs=1 seek=$i conv=notrunc 2>/dev/null
+	what="$entry with a huge varint at byte $i"; check "$@"
+
+	cp cache_test.entry $entry
+	printf '\000' | dd of=$entry bs=1 seek=$i conv=notrunc 2>/dev/null
+	what="$entry with a 0 at byte $i"; check "$@"
+
+	head -c $i cache_test.entry >$entry
+	what="$entry cut short at byte $i"; check "$@"
+	i=`expr $i + 1`
+    done
+    cp cache_test.entry $entry
+done
+
+rm -rf $dir cache_test.full cache_test.out cache_test.entry
+if [ $failures -ne 0 ]; then
+    echo "cache_test: $failures checks failed"
+    exit 1
+fi
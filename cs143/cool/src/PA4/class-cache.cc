@@ -0,0 +1,356 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  class-cache.cc
+//
+//  Incremental parsing for coolc -i, a class at a time.  A COOL file is
+//  a list of classes, each from a CLASS keyword up to the next one, and
+//  a class lexes and parses the same whatever comes before or after it.
+//  So the scanner and parser need only see the classes that have
+//  changed since the last compile; the others are read back from a
+//  cache of the trees built then.
+//
+//  find_classes splits the source text at each CLASS keyword, skipping
+//  comments and strings as the scanner does, and counting lines as it
+//  goes; it is much cheaper than the scanner, as it looks at each byte
+//  once and interns nothing.  A class's span of the text runs from its
+//  keyword to the next one, or to the end, so the comments and white
+//  space after a class go with it.  Each span is hashed, with the file
+//  name: moving a class up or down the file does not change its hash;
+//  editing it does.  A class whose hash is in the cache directory is
+//  read from there, in the binary form of write_binary_class (see
+//  ast-binary.cc), with its line numbers moved to where the class is
+//  now.  The entry holds the span it was parsed from, and is used only
+//  if that is the class's span now, byte for byte, so that two spans
+//  with the same hash never share a tree.  Any other class, or one
+//  whose entry is damaged, is lexed and parsed on its own, from its
+//  span alone, and then saved in the cache.
+//
+//  The classes are joined in the order of the file, and the program
+//  takes the line of the first class, as in a parse of the whole file.
+//  A file with anything else before its first class, or whose changed
+//  classes have lexical or syntax errors, is left to be parsed whole,
+//  which reports the errors just as before.
+//
+//  The cache never needs cleaning for correctness: an entry is named by
+//  the hash of the text it was parsed from.  Entries are written under
+//  a temporary name and renamed, so that compiles running at the same
+//  time never read a partial one.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>     // for mkstemp
+#include <string.h>
+#include <unistd.h>     // for unlink
+#include "cool-tree.h"
+#include "stringtab.h"
+#include "utilities.h"
+#include "class-cache.h"
+
+extern __thread int node_lineno;  // the line number of new nodes
+
+extern void write_binary_class(Class_ c, char *text, int len, int lineno,
+			       FILE *f);
+extern Class_ read_binary_class(FILE *f, char *text, int len, int lineno);
+
+//
+// The span of the text that holds one class, from its CLASS keyword,
+// which is on line lineno.
+//
+struct class_span {
+  char *text;
+  int len;
+  int lineno;
+};
+
+static inline int is_letter(int c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static inline int is_digit(int c) { return c >= '0' && c <= '9'; }
+
+//
+// Find the classes in the len bytes at text, and return how many there
+// are, with their spans in *spans (which the caller deletes); or return
+// 0 if there is no class, or anything but comments and white space
+// before the first.  The tokens are told apart as the scanner (see
+// cool.flex) tells them apart, so that a CLASS found here is one that
+// the scanner returns: comments nest, a string ends at a newline that
+// is not escaped, and "<-" is one token, so that "<--" does not start
+// a comment.
+//
+static int find_classes(char *text, int len, class_span **spans)
+{
+  unsigned char *p = (unsigned char *) text;
+  unsigned char *end = p + len;
+  int lineno = 1;
+  int n = 0, cap = 64;
+  class_span *s = new class_span[cap];
+
+  while (p < end) {
+    unsigned char *start = p;
+    if (*p == '\n') {
+      lineno++;
+      p++;
+      continue;
+    }
+    if (*p == ' ' || *p == '\t' || *p == '\f' || *p == '\r' || *p == '\v') {
+      p++;
+      continue;
+    }
+    if (is_letter(*p)) {
+      while (++p < end && (is_letter(*p) || is_digit(*p) || *p == '_'))
+	;
+      if (p - start == 5 && (start[0] | 0x20) == 'c' &&
+	  (start[1] | 0x20) == 'l' && (start[2] | 0x20) == 'a' &&
+	  (start[3] | 0x20) == 's' && (start[4] | 0x20) == 's') {
+	if (n == cap) {
+	  class_span *bigger = new class_span[2 * cap];
+	  memcpy(bigger, s, cap * sizeof(class_span));
+	  delete [] s;
+	  s = bigger;
+	  cap *= 2;
+	}
+	s[n].text = (char *) start;
+	s[n].lineno = lineno;
+	n++;
+	continue;
+      }
+    } else if (is_digit(*p)) {
+      while (++p < end && is_digit(*p))
+	;
+    } else if (*p == '-' && p + 1 < end && p[1] == '-') {
+      while (p < end && *p != '\n')
+	p++;
+      continue;
+    } else if (*p == '(' && p + 1 < end && p[1] == '*') {
+      int nesting = 1;
+      for (p += 2; p < end && nesting > 0; p++) {
+	if (*p == '\n')
+	  lineno++;
+	else if (*p == '(' && p + 1 < end && p[1] == '*')
+	  nesting++, p++;
+	else if (*p == '*' && p + 1 < end && p[1] == ')')
+	  nesting--, p++;
+      }
+      continue;
+    } else if (*p == '"') {
+      for (p++; p < end && *p != '"' && *p != '\n'; p++)
+	if (*p == '\\' && p + 1 < end) {
+	  if (p[1] == '\n')
+	    lineno++;
+	  p++;
+	}
+      if (p < end) {
+	if (*p == '\n')
+	  lineno++;
+	p++;
+      }
+    } else if (*p == '<' && p + 1 < end && p[1] == '-')
+      p += 2;
+    else
+      p++;
+    if (n == 0) {                // a token before the first class
+      delete [] s;
+      return 0;
+    }
+  }
+
+  for (int i = 0; i < n; i++)
+    s[i].len = (i + 1 < n ? s[i + 1].text : (char *) end) - s[i].text;
+  if (n == 0)
+    delete [] s;
+  else
+    *spans = s;
+  return n;
+}
+
+//
+// The hash mixes in a 64-bit word at a time, multiplying by the golden
+// ratio and folding the high bits down.  It need only tell apart the
+// versions of a class, not resist anyone trying to collide them.
+//
+typedef unsigned long long class_hash;
+
+static inline class_hash mix(class_hash h, class_hash w)
+{
+  h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+  return h ^ (h >> 32);
+}
+
+static class_hash mix_chars(class_hash h, char *s, int len)
+{
+  class_hash w;
+
+  h = mix(h, len);
+  for (; len >= 8; s += 8, len -= 8) {
+    memcpy(&w, s, 8);
+    h = mix(h, w);
+  }
+  if (len > 0) {
+    w = 0;
+    memcpy(&w, s, len);
+    h = mix(h, w);
+  }
+  return h;
+}
+
+//
+// Parse one class from its tokens.  At the end of them the parser sees
+// the end of the input, on the line of the token that follows.
+//
+struct class_tokens {
+  lexed_token *next;
+  lexed_token *end;
+};
+
+static int read_class_tokens(parse_context *ctx, YYSTYPE *lval, int *lineno)
+{
+  class_tokens *ct = (class_tokens *) ctx->data;
+  lexed_token *t = ct->next;
+
+  *lval = t->lval;
+  *lineno = t->lineno;
+  if (t == ct->end)
+    return 0;
+  ct->next++;
+  return t->token;
+}
+
+static void ignore_error(parse_context *, char *) { }
+
+static Class_ parse_class(char *filename, lexed_token *t, lexed_token *end)
+{
+  class_tokens ct = { t, end };
+  parse_context ctx;
+
+  init_parse_context(&ctx, filename, read_class_tokens, &ct);
+  ctx.report_error = ignore_error;
+  if (pratt_parser)
+    pratt_parse(&ctx);
+  else
+    cool_yyparse(&ctx);
+  if (ctx.errors != 0 || ctx.program == NULL || ctx.classes->len() != 1)
+    return NULL;
+  return ctx.classes->nth(ctx.classes->first());
+}
+
+//
+// Lex and parse the class in span on its own, with lx.  The scanner
+// needs two NULs after its text, so the span is copied out first.
+// Return NULL if the class has lexical or syntax errors.
+//
+static Class_ lex_and_parse_class(cool_lexer *lx, char *filename,
+				  class_span *span)
+{
+  char *text = new char[span->len + 2];
+  memcpy(text, span->text, span->len);
+  text[span->len] = text[span->len + 1] = '\0';
+  cool_lexer_text(lx, text, span->len + 2);
+  lx->lineno = span->lineno;
+
+  int n = 0, cap = 1024;
+  lexed_token *tokens = new lexed_token[cap];
+  Class_ c = NULL;
+  for (;;) {
+    if (n == cap) {
+      lexed_token *bigger = new lexed_token[2 * cap];
+      memcpy(bigger, tokens, cap * sizeof(lexed_token));
+      delete [] tokens;
+      tokens = bigger;
+      cap *= 2;
+    }
+    lexed_token *t = &tokens[n];
+    t->token = cool_lexer_token(lx);
+    t->lval = lx->lval;
+    t->lineno = lx->lineno;
+    if (t->token == ERROR)
+      break;
+    if (t->token == 0) {
+      c = parse_class(filename, tokens, t);
+      break;
+    }
+    n++;
+  }
+  delete [] tokens;
+  delete [] text;
+  return c;
+}
+
+static void save_class(char *path, Class_ c, class_span *span)
+{
+  char tmp[1024];
+  snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+  int fd = mkstemp(tmp);
+  if (fd < 0)
+    return;
+  FILE *f = fdopen(fd, "w");
+  if (f == NULL) {
+    close(fd);
+    unlink(tmp);
+    return;
+  }
+  write_binary_class(c, span->text, span->len, span->lineno, f);
+  if (fclose(f) != 0 || rename(tmp, path) != 0)
+    unlink(tmp);
+}
+
+//
+// Look a class up in the cache, or lex and parse it and save it there.
+//
+static Class_ cached_class(char *dir, char *filename, cool_lexer *lx,
+			   class_span *span)
+{
+  class_hash h = mix_chars(0, filename, strlen(filename));
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/%016llx", dir,
+	   mix_chars(h, span->text, span->len));
+
+  Class_ c = NULL;
+  FILE *f = fopen(path, "r");
+  if (f != NULL) {
+    c = read_binary_class(f, span->text, span->len, span->lineno);
+    fclose(f);
+  }
+  if (c == NULL) {
+    c = lex_and_parse_class(lx, filename, span);
+    if (c != NULL)
+      save_class(path, c, span);
+  }
+  return c;
+}
+
+int parse_cached_classes(parse_context *ctx, cool_lexer *lx, char *text,
+			 size_t len, char *dir)
+{
+  class_span *spans;
+  Classes classes = NULL;
+
+  int n = find_classes(text, len - 2, &spans);
+  if (n == 0)
+    return 0;
+  for (int i = 0; i < n; i++) {
+    Class_ c = cached_class(dir, ctx->filename, lx, &spans[i]);
+    if (c == NULL) {
+      classes = NULL;
+      break;
+    }
+    classes = classes == NULL ? single_Classes(c) : extend_list(classes, c);
+  }
+  int lineno = spans[0].lineno;
+  delete [] spans;
+  if (classes == NULL)
+    return 0;
+
+  ctx->classes = classes;
+  node_lineno = lineno;
+  ctx->program = program(classes);
+  return 1;
+}
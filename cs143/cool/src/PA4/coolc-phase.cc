@@ -0,0 +1,251 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  coolc-phase.cc
+//
+//  A single-process front end.  `mycoolc' runs each phase as a separate
+//  program, and each phase prints its result as text for the next one to
+//  scan and parse again:
+//
+//      ./lexer foo.cl | ./parser | ./semant | ./cgen
+//
+//  This driver links the flex scanner (../PA2/cool.flex), the bison
+//  parser (../PA3/cool.y), or with -P the hand-written one (see
+//  pratt-parse.cc), and program_class::semant into one program.
+//  The parser pulls tokens straight from the scanner, and semant checks
+//  the tree the parser built, so the token stream and the untyped AST
+//  are never printed or read back.  The result is the annotated AST,
+//  exactly as `semant' prints it, ready for the code generator:
+//
+//      ./coolc foo.cl | ./cgen
+//
+//  The scanner hands its tokens to the parser in batches, through a
+//  TokenRing (see token-ring.h).  With -j n, for n > 1, the files are
+//  parsed n at a time, each on a thread of its own with its own lexer,
+//  parser (see parse-context.h) and AST arena; a single file is instead
+//  lexed on one thread while it is parsed on another.  Each file's
+//  syntax errors are kept until all the files are parsed, and then
+//  printed in the order of the files, just as a parse of one file after
+//  another would print them.  The classes of the files are joined in
+//  the same order.
+//
+//  With -i directory, the parse is incremental: only the classes that
+//  have changed since the last compile with the same directory are
+//  lexed and parsed, and the others are taken from the trees saved
+//  there (see class-cache.cc).  Each file is then mapped, as with -m,
+//  and the string tables are in concurrent mode even for one file, so
+//  that the symbols are numbered the same whichever classes were
+//  parsed.
+//
+//  With -m each file is mapped and scanned in place (see lextest.cc).
+//  With -B the annotated AST is written in its binary form instead.
+//  The phase programs are still built as before, for debugging.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>     // for Linux system
+#include <unistd.h>    // for getopt
+#include <sys/stat.h>  // for mkdir
+#include <pthread.h>
+#include <sstream>
+#include "cool-io.h"  //includes iostream
+#include "cool-tree.h"
+#include "utilities.h"  // for fatal_error
+#include "cool-parse.h"
+#include "cool-lex.h"
+#include "parse-context.h"
+#include "token-ring.h"
+#include "class-cache.h"
+
+FILE *fin;                       // read by cool_yylex, which is not used here
+char *curr_filename = "<stdin>"; // for the phases' error messages
+
+extern Program ast_root;         // the AST produced by the parse
+extern int omerrs;               // a count of lex and parse errors
+extern __thread int node_lineno; // the line number of new nodes
+
+extern int optind;               // used for option processing
+
+void handle_flags(int argc, char *argv[]);
+
+//
+// The parse of one file.  The syntax errors are kept in errors, one per
+// line, until they are printed.
+//
+struct file_parse {
+    char *filename;
+    TokenRing *ring;
+    parse_context ctx;
+    std::ostringstream errors;
+};
+
+static int read_ring(parse_context *ctx, YYSTYPE *lval, int *lineno)
+{
+    return ((file_parse *) ctx->data)->ring->next(lval, lineno);
+}
+
+static void keep_error(parse_context *ctx, char *msg)
+{
+    print_parse_error(((file_parse *) ctx->data)->errors, ctx->filename,
+		      ctx->lineno, msg, ctx->token, &ctx->lval);
+}
+
+// Lex and parse one file, with the lexer on a thread of its own if lex_thread.
+static void parse_file(file_parse *fp, int lex_thread)
+{
+    cool_lexer *lx = new_cool_lexer();
+    char *text;
+    size_t len;
+    FILE *f;
+
+    // The class cache finds the classes in the text, so needs it mapped.
+    int mapped = mmap_input || class_cache;
+    if (mapped) {
+	text = map_source_file(fp->filename, &len);
+	if (text == NULL) {
+	    cerr << "Could not map input file " << fp->filename << endl;
+	    exit(1);
+	}
+    } else {
+	f = fopen(fp->filename, "r");
+	if (f == NULL) {
+	    cerr << "Could not open input file " << fp->filename << endl;
+	    exit(1);
+	}
+    }
+    init_parse_context(&fp->ctx, fp->filename, read_ring, fp);
+    fp->ctx.report_error = keep_error;
+    if (!class_cache ||
+	!parse_cached_classes(&fp->ctx, lx, text, len, class_cache)) {
+	if (mapped)
+	    cool_lexer_text(lx, text, len);
+	else
+	    cool_lexer_file(lx, f);
+	fp->ring = new TokenRing(lx, lex_thread);
+	if (pratt_parser)
+	    pratt_parse(&fp->ctx);
+	else
+	    cool_yyparse(&fp->ctx);
+	delete fp->ring;
+    }
+    if (mapped)
+	unmap_source_file(text, len);
+    else
+	fclose(f);
+    delete_cool_lexer(lx);
+}
+
+//
+// The parser threads take the files in turn.  The nodes of each thread's
+// files are kept in an arena of its own, which lives as long as coolc.
+//
+static file_parse *files;
+static int nfiles;
+static int next_file;
+static pthread_mutex_t next_file_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *parser_thread(void *)
+{
+    set_ast_arena(new ast_arena);
+    for (;;) {
+	pthread_mutex_lock(&next_file_lock);
+	int i = next_file++;
+	pthread_mutex_unlock(&next_file_lock);
+	if (i >= nfiles)
+	    break;
+	parse_file(&files[i], 0);
+    }
+    return NULL;
+}
+
+//
+// Print a file's syntax errors.  As in the parser of one file, coolc
+// stops after too many of them, counting all the files so far.
+//
+static int errors_printed;
+
+static void print_errors(file_parse *fp)
+{
+    std::string text = fp->errors.str();
+    size_t pos = 0, eol;
+
+    while ((eol = text.find('\n', pos)) != std::string::npos) {
+	cerr << text.substr(pos, eol + 1 - pos);
+	pos = eol + 1;
+	if (++errors_printed > MAX_PARSE_ERRORS) {
+	    fprintf(stdout, "More than %d errors\n", MAX_PARSE_ERRORS);
+	    exit(1);
+	}
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Classes classes = nil_Classes();
+    int nthreads;
+
+    handle_flags(argc, argv);
+    nfiles = argc - optind;
+    files = new file_parse[nfiles];
+    for (int i = 0; i < nfiles; i++)
+	files[i].filename = argv[optind + i];
+    nthreads = lex_threads < nfiles ? lex_threads : nfiles;
+    if (lex_threads > 1 || class_cache)
+	begin_concurrent_interning();
+    if (class_cache)
+	mkdir(class_cache, 0777);
+
+    //
+    // Parse the files, on threads or one after another; the program is
+    // made of all their classes.
+    //
+    if (nthreads > 1) {
+	pthread_t *threads = new pthread_t[nthreads];
+	for (int i = 0; i < nthreads; i++)
+	    pthread_create(&threads[i], NULL, parser_thread, NULL);
+	for (int i = 0; i < nthreads; i++)
+	    pthread_join(threads[i], NULL);
+	delete [] threads;
+    } else {
+	for (int i = 0; i < nfiles; i++) {
+	    parse_file(&files[i], lex_threads > 1);
+	    print_errors(&files[i]);
+	}
+    }
+    for (int i = 0; i < nfiles; i++) {
+	if (nthreads > 1)
+	    print_errors(&files[i]);
+	omerrs += files[i].ctx.errors;
+	if (omerrs == 0)
+	    classes = append_Classes(classes, files[i].ctx.classes);
+    }
+    if (lex_threads > 1 || class_cache)
+	canonicalize_interning();
+    if (omerrs != 0) {
+	cerr << "Compilation halted due to lex and parse errors\n";
+	exit(1);
+    }
+
+    //
+    // With one file, keep the parser's own program node.  Otherwise the
+    // program takes its line number from the last file's, as it would
+    // if the files were parsed one after another on this thread.
+    //
+    if (nfiles == 1)
+	ast_root = files[0].ctx.program;
+    else {
+	if (nfiles > 1)
+	    node_lineno = files[nfiles - 1].ctx.program->get_line_number();
+	ast_root = program(classes);
+    }
+    ast_root->semant();
+    if (binary_ast)
+	ast_root->write_binary(stdout);
+    else
+	ast_root->dump_with_types(cout, 0);
+    return 0;
+}
@@ -0,0 +1,818 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  pratt-parse.cc
+//
+//  A hand-written parser for COOL, used in place of the bison parser
+//  (cool.y) with -P.  It reads the same tokens through a parse_context
+//  (see parse-context.h) and builds the same tree: the same nodes, with
+//  the same line numbers, interning "self", "Object" and the file name
+//  at the same points in the token stream.  Only the line numbers of
+//  the lists may differ, and those are never used.
+//
+//  Expressions are parsed by precedence climbing: parse_expr parses an
+//  operand and then every binary or postfix operator of at least a given
+//  precedence, with the levels of cool.y's precedence declarations.  The
+//  rest is recursive descent, a function per nonterminal.
+//
+//  Syntax errors are found at the same tokens as bison finds them, and
+//  recovered from as bison would, so the errors reported are the same.
+//  An error is reported unless another came less than three tokens
+//  before, and is then handed to the innermost construct with an error
+//  production that bison would still have on its stack:
+//
+//      class_list   : error ';' class_list       parse_program
+//      feature_list : error ';' feature_list     parse_class_body
+//      block_exprs  : error ';' block_exprs      parse_block
+//      expr         : '{' error '}'              parse_block
+//      let_list     : error                      parse_let_list
+//
+//  Until then, unwinding is set and every function returns at once.
+//  Like bison, the parser reads a token only when it must see it.
+//
+//  Bison stops with "memory exhausted" when its stack would grow past
+//  MAX_PARSE_DEPTH entries.  This parser stops the same way when its
+//  expressions and let bindings nest MAX_PARSE_DEPTH deep, before the
+//  recursion can overflow the C stack.  A level may take bison more
+//  than one entry, such as the left operand and operator before a '(',
+//  or the four tokens of a let binding, so bison may give up sooner.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "cool-tree.h"
+#include "stringtab.h"
+#include "utilities.h"
+#include "parse-context.h"
+
+extern __thread int node_lineno;  // the line number of new nodes
+
+struct pratt {
+  parse_context *ctx;
+  int have;                      // has the lookahead been read?
+  int token;                     // the lookahead; its value and line
+                                 //   number are in ctx
+  int errstatus;                 // tokens to shift before errors are
+                                 //   reported again, as bison counts them
+  int unwinding;                 // an error is on its way to recovery
+  int aborted;                   // the input ended during recovery, or
+                                 //   the nesting went too deep
+  int depth;                     // the expressions and let bindings
+                                 //   being parsed
+};
+
+// The precedence levels of cool.y, lowest first.
+enum { PREC_ASSIGN = 1, PREC_NOT, PREC_CMP, PREC_ADD, PREC_MUL,
+       PREC_ISVOID, PREC_NEG, PREC_AT, PREC_DOT };
+
+static Expression parse_expr(pratt *p, int min);
+static Expression parse_block(pratt *p, int lineno);
+static Expression parse_let_list(pratt *p);
+
+//
+// Read the lookahead, if it has not been, as cool.y's yylex does: after
+// too many errors, the input ends there.
+//
+static inline int peek(pratt *p)
+{
+  if (!p->have) {
+    parse_context *ctx = p->ctx;
+    if (ctx->errors > MAX_PARSE_ERRORS)
+      p->token = 0;
+    else {
+      p->token = ctx->token =
+	ctx->read_token(ctx, &ctx->lval, &ctx->lineno);
+      if (ctx->stats != NULL)
+	ctx->stats->tokens++;
+    }
+    p->have = 1;
+  }
+  return p->token;
+}
+
+// Take the lookahead; its value and line number stay in ctx until the
+// next token is read.
+static inline void shift(pratt *p)
+{
+  p->have = 0;
+  if (p->errstatus)
+    p->errstatus--;
+}
+
+//
+// A syntax error at the lookahead.  Bison drops the lookahead instead of
+// reporting it if the last error was just before it, and gives up if
+// that lookahead is the end of the input.
+//
+static void syntax_error(pratt *p)
+{
+  parse_context *ctx = p->ctx;
+
+  if (p->errstatus == 0) {
+    if (ctx->errors <= MAX_PARSE_ERRORS) {
+      ctx->errors++;
+      ctx->report_error(ctx, "syntax error");
+    }
+  } else if (p->errstatus == 3) {
+    if (p->token == 0)
+      p->aborted = 1;
+    else
+      p->have = 0;
+  }
+  p->errstatus = 3;
+  p->unwinding = 1;
+}
+
+//
+// Enter an expression or let binding, unless that nests them deeper
+// than bison's stack could: then report it as bison does, and give up.
+//
+static int nest(pratt *p)
+{
+  parse_context *ctx = p->ctx;
+
+  if (p->depth == MAX_PARSE_DEPTH) {
+    if (ctx->errors <= MAX_PARSE_ERRORS) {
+      ctx->errors++;
+      ctx->report_error(ctx, "memory exhausted");
+    }
+    p->aborted = p->unwinding = 1;
+    return 0;
+  }
+  p->depth++;
+  if (ctx->stats != NULL && p->depth > ctx->stats->max_depth)
+    ctx->stats->max_depth = p->depth;
+  return 1;
+}
+
+//
+// Recover from an error after the error token: drop tokens up to one
+// that may follow it, a or b, and return that token, unshifted.  If the
+// input ends first, give up and return 0.
+//
+static int skip_to(pratt *p, int a, int b)
+{
+  p->unwinding = 0;
+  for (;;) {
+    int token = peek(p);
+    if (token == a || token == b)
+      return token;
+    if (token == 0) {
+      p->aborted = p->unwinding = 1;
+      return 0;
+    }
+    p->have = 0;
+  }
+}
+
+static inline int expect(pratt *p, int token)
+{
+  if (peek(p) == token) {
+    shift(p);
+    return 1;
+  }
+  syntax_error(p);
+  return 0;
+}
+
+// Shift a TYPEID or OBJECTID and return its symbol.
+static inline Symbol expect_symbol(pratt *p, int token)
+{
+  if (peek(p) != token) {
+    syntax_error(p);
+    return NULL;
+  }
+  shift(p);
+  return p->ctx->lval.symbol;
+}
+
+// The precedence of a binary or postfix operator, or 0.
+static inline int infix_prec(int token)
+{
+  switch (token) {
+  case LE: case '<': case '=':  return PREC_CMP;
+  case '+': case '-':           return PREC_ADD;
+  case '*': case '/':           return PREC_MUL;
+  case '@':                     return PREC_AT;
+  case '.':                     return PREC_DOT;
+  default:                      return 0;
+  }
+}
+
+static inline int starts_expr(int token)
+{
+  switch (token) {
+  case IF: case LET: case WHILE: case CASE: case NEW: case ISVOID:
+  case STR_CONST: case INT_CONST: case BOOL_CONST: case OBJECTID:
+  case NOT: case '~': case '{': case '(':
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+//
+// The arguments of a dispatch, after the '(', through the ')'.  As in
+// cool.y, a ',' may come first, after an empty argument.
+//
+static Expressions parse_args(pratt *p)
+{
+  Expressions args;
+  Expression e;
+
+  if (starts_expr(peek(p))) {
+    e = parse_expr(p, 0);
+    if (p->unwinding)
+      return NULL;
+    args = single_Expressions(e);
+  } else
+    args = nil_Expressions();
+  while (peek(p) == ',') {
+    shift(p);
+    e = parse_expr(p, 0);
+    if (p->unwinding)
+      return NULL;
+    args = extend_list(args, e);
+  }
+  if (!expect(p, ')'))
+    return NULL;
+  return args;
+}
+
+// The rest of a dispatch on e, after its '.' or '@'.
+static Expression parse_dispatch(pratt *p, Expression e, int token,
+				 int lineno)
+{
+  Symbol type = NULL;
+
+  if (token == '@') {
+    type = expect_symbol(p, TYPEID);
+    if (p->unwinding || !expect(p, '.'))
+      return NULL;
+  }
+  Symbol name = expect_symbol(p, OBJECTID);
+  if (p->unwinding || !expect(p, '('))
+    return NULL;
+  Expressions args = parse_args(p);
+  if (p->unwinding)
+    return NULL;
+  node_lineno = lineno;
+  if (type != NULL)
+    return static_dispatch(e, type, name, args);
+  return dispatch(e, name, args);
+}
+
+// A case branch, through its ';'.
+static Case parse_branch(pratt *p)
+{
+  Symbol name = expect_symbol(p, OBJECTID);
+  int lineno = p->ctx->lineno;
+  if (p->unwinding || !expect(p, ':'))
+    return NULL;
+  Symbol type = expect_symbol(p, TYPEID);
+  if (p->unwinding || !expect(p, DARROW))
+    return NULL;
+  Expression e = parse_expr(p, 0);
+  if (p->unwinding || !expect(p, ';'))
+    return NULL;
+  node_lineno = lineno;
+  return branch(name, type, e);
+}
+
+//
+// An expression that does not start with another: anything but a
+// binary or postfix operator.  Its nodes take the line of its first
+// token.
+//
+static Expression parse_primary(pratt *p)
+{
+  parse_context *ctx = p->ctx;
+  int token = peek(p);
+  int lineno = ctx->lineno;
+  Symbol sym;
+  Expression e1, e2, e3;
+  Expressions args;
+  Cases cases;
+
+  switch (token) {
+  case OBJECTID:
+    sym = ctx->lval.symbol;
+    shift(p);
+    if (peek(p) == ASSIGN) {
+      shift(p);
+      e1 = parse_expr(p, 0);
+      if (p->unwinding)
+	return NULL;
+      node_lineno = lineno;
+      return assign(sym, e1);
+    }
+    if (p->token == '(') {
+      shift(p);
+      args = parse_args(p);
+      if (p->unwinding)
+	return NULL;
+      node_lineno = lineno;
+      return dispatch(object(idtable.add_string("self")), sym, args);
+    }
+    node_lineno = lineno;
+    return object(sym);
+
+  case INT_CONST:
+    shift(p);
+    node_lineno = lineno;
+    return int_const(ctx->lval.symbol);
+
+  case STR_CONST:
+    shift(p);
+    node_lineno = lineno;
+    return string_const(ctx->lval.symbol);
+
+  case BOOL_CONST:
+    shift(p);
+    node_lineno = lineno;
+    return bool_const(ctx->lval.boolean);
+
+  case '(':
+    shift(p);
+    e1 = parse_expr(p, 0);
+    if (p->unwinding || !expect(p, ')'))
+      return NULL;
+    return e1;
+
+  case IF:
+    shift(p);
+    e1 = parse_expr(p, 0);
+    if (p->unwinding || !expect(p, THEN))
+      return NULL;
+    e2 = parse_expr(p, 0);
+    if (p->unwinding || !expect(p, ELSE))
+      return NULL;
+    e3 = parse_expr(p, 0);
+    if (p->unwinding || !expect(p, FI))
+      return NULL;
+    node_lineno = lineno;
+    return cond(e1, e2, e3);
+
+  case WHILE:
+    shift(p);
+    e1 = parse_expr(p, 0);
+    if (p->unwinding || !expect(p, LOOP))
+      return NULL;
+    e2 = parse_expr(p, 0);
+    if (p->unwinding || !expect(p, POOL))
+      return NULL;
+    node_lineno = lineno;
+    return loop(e1, e2);
+
+  case '{':
+    shift(p);
+    return parse_block(p, lineno);
+
+  case LET:
+    shift(p);
+    return parse_let_list(p);
+
+  case CASE:
+    shift(p);
+    e1 = parse_expr(p, 0);
+    if (p->unwinding || !expect(p, OF))
+      return NULL;
+    cases = NULL;
+    do {
+      Case c = parse_branch(p);
+      if (p->unwinding)
+	return NULL;
+      cases = cases == NULL ? single_Cases(c) : extend_list(cases, c);
+    } while (peek(p) == OBJECTID);
+    if (!expect(p, ESAC))
+      return NULL;
+    node_lineno = lineno;
+    return typcase(e1, cases);
+
+  case NEW:
+    shift(p);
+    sym = expect_symbol(p, TYPEID);
+    if (p->unwinding)
+      return NULL;
+    node_lineno = lineno;
+    return new_(sym);
+
+  case ISVOID:
+    shift(p);
+    e1 = parse_expr(p, PREC_ISVOID + 1);
+    if (p->unwinding)
+      return NULL;
+    node_lineno = lineno;
+    return isvoid(e1);
+
+  case NOT:
+    shift(p);
+    e1 = parse_expr(p, PREC_NOT + 1);
+    if (p->unwinding)
+      return NULL;
+    node_lineno = lineno;
+    return comp(e1);
+
+  case '~':
+    shift(p);
+    e1 = parse_expr(p, PREC_NEG + 1);
+    if (p->unwinding)
+      return NULL;
+    node_lineno = lineno;
+    return neg(e1);
+
+  default:
+    syntax_error(p);
+    return NULL;
+  }
+}
+
+//
+// An expression whose binary operators all have a precedence of at
+// least min; 0 takes any expression.  The operators' nodes all take the
+// line of the expression's first token, as cool.y's take that of their
+// left operand.
+//
+static Expression climb(pratt *p, int min)
+{
+  peek(p);
+  int lineno = p->ctx->lineno;
+  Expression e = parse_primary(p);
+  int compared = 0;              // was the last operator a comparison?
+
+  for (;;) {
+    if (p->unwinding)
+      return NULL;
+    int token = peek(p);
+    int prec = infix_prec(token);
+    if (prec == 0 || prec < min)
+      return e;
+    if (prec == PREC_CMP && compared) {   // comparisons are nonassoc
+      syntax_error(p);
+      return NULL;
+    }
+    shift(p);
+    if (token == '.' || token == '@') {
+      e = parse_dispatch(p, e, token, lineno);
+      continue;
+    }
+    Expression rhs = parse_expr(p, prec + 1);
+    if (p->unwinding)
+      return NULL;
+    node_lineno = lineno;
+    switch (token) {
+    case '+': e = plus(e, rhs); break;
+    case '-': e = sub(e, rhs); break;
+    case '*': e = mul(e, rhs); break;
+    case '/': e = divide(e, rhs); break;
+    case '<': e = lt(e, rhs); break;
+    case LE:  e = leq(e, rhs); break;
+    case '=': e = eq(e, rhs); break;
+    }
+    compared = prec == PREC_CMP;
+  }
+}
+
+// climb, keeping count of how deeply expressions nest.
+static Expression parse_expr(pratt *p, int min)
+{
+  if (!nest(p))
+    return NULL;
+  Expression e = climb(p, min);
+  p->depth--;
+  return e;
+}
+
+// The `expr ;' items of a block, as many as there are.
+static Expressions parse_block_exprs(pratt *p)
+{
+  Expressions body = NULL;
+
+  do {
+    Expression e = parse_expr(p, 0);
+    if (p->unwinding || !expect(p, ';'))
+      return NULL;
+    body = body == NULL ? single_Expressions(e) : extend_list(body, e);
+  } while (starts_expr(peek(p)));
+  return body;
+}
+
+//
+// A block, after its '{', through its '}'.  After an error the block
+// ends at the next '}', or starts again after the next ';'; once it has
+// started again, an error skips to the next ';' whatever comes first.
+//
+static Expression parse_block(pratt *p, int lineno)
+{
+  Expressions body = parse_block_exprs(p);
+
+  for (;;) {
+    if (!p->unwinding) {
+      if (peek(p) == '}') {
+	shift(p);
+	node_lineno = lineno;
+	return block(body);
+      }
+      syntax_error(p);
+    }
+    if (p->aborted)
+      return NULL;
+    int token = skip_to(p, '}', ';');
+    if (token == 0)
+      return NULL;
+    shift(p);
+    if (token == '}') {          // '{' error '}'
+      p->errstatus = 0;
+      return NULL;
+    }
+    for (;;) {                   // error ';' block_exprs
+      body = parse_block_exprs(p);
+      if (!p->unwinding)
+	break;
+      if (p->aborted || !skip_to(p, ';', ';'))
+	return NULL;
+      shift(p);
+    }
+    p->errstatus = 0;
+  }
+}
+
+// One binding of a let, and the rest of the let after it.
+static Expression parse_let_binding(pratt *p)
+{
+  Symbol name = expect_symbol(p, OBJECTID);
+  int lineno = p->ctx->lineno;
+  if (p->unwinding || !expect(p, ':'))
+    return NULL;
+  Symbol type = expect_symbol(p, TYPEID);
+  if (p->unwinding)
+    return NULL;
+
+  Expression init = NULL, body;
+  if (peek(p) == ASSIGN) {
+    shift(p);
+    init = parse_expr(p, 0);
+    if (p->unwinding)
+      return NULL;
+  }
+  if (peek(p) == IN) {
+    shift(p);
+    body = parse_expr(p, 0);
+  } else if (p->token == ',') {
+    shift(p);
+    body = parse_let_list(p);
+  } else {
+    syntax_error(p);
+    return NULL;
+  }
+  if (p->unwinding)
+    return NULL;
+  node_lineno = lineno;
+  return let(name, type, init != NULL ? init : no_expr(), body);
+}
+
+//
+// The bindings and body of a let, after its LET or a ','.  An error in
+// them ends the let there, and the lookahead is left for what follows
+// it, where it may well be reported again.
+//
+static Expression parse_let_list(pratt *p)
+{
+  if (!nest(p))
+    return NULL;
+  Expression e = parse_let_binding(p);
+  p->depth--;
+
+  if (p->unwinding && !p->aborted) {
+    p->unwinding = 0;
+    p->errstatus = 0;
+  }
+  return e;
+}
+
+static Formal parse_formal(pratt *p)
+{
+  Symbol name = expect_symbol(p, OBJECTID);
+  int lineno = p->ctx->lineno;
+  if (p->unwinding || !expect(p, ':'))
+    return NULL;
+  Symbol type = expect_symbol(p, TYPEID);
+  if (p->unwinding)
+    return NULL;
+  node_lineno = lineno;
+  return formal(name, type);
+}
+
+// The formals of a method, after the '(', through the ')'.  As with
+// arguments, a ',' may come first.
+static Formals parse_formals(pratt *p)
+{
+  Formals formals;
+  Formal f;
+
+  if (peek(p) == OBJECTID) {
+    f = parse_formal(p);
+    if (p->unwinding)
+      return NULL;
+    formals = single_Formals(f);
+  } else
+    formals = nil_Formals();
+  while (peek(p) == ',') {
+    shift(p);
+    f = parse_formal(p);
+    if (p->unwinding)
+      return NULL;
+    formals = extend_list(formals, f);
+  }
+  if (!expect(p, ')'))
+    return NULL;
+  return formals;
+}
+
+//
+// A feature, from its name through its ';'.  A method's body is an
+// expression, which need not be a block.
+//
+static Feature parse_feature(pratt *p)
+{
+  parse_context *ctx = p->ctx;
+  Symbol name = ctx->lval.symbol;
+  int lineno = ctx->lineno;
+  Symbol type;
+  Expression e;
+
+  shift(p);
+  if (peek(p) == '(') {
+    shift(p);
+    Formals formals = parse_formals(p);
+    if (p->unwinding || !expect(p, ':'))
+      return NULL;
+    type = expect_symbol(p, TYPEID);
+    if (p->unwinding || !expect(p, '{'))
+      return NULL;
+    e = parse_expr(p, 0);
+    if (p->unwinding || !expect(p, '}') || !expect(p, ';'))
+      return NULL;
+    node_lineno = lineno;
+    return method(name, formals, type, e);
+  }
+
+  if (!expect(p, ':'))
+    return NULL;
+  type = expect_symbol(p, TYPEID);
+  if (p->unwinding)
+    return NULL;
+  if (peek(p) == ';') {
+    shift(p);
+    node_lineno = lineno;
+    return attr(name, type, no_expr());
+  }
+  if (!expect(p, ASSIGN))
+    return NULL;
+  e = parse_expr(p, 0);
+  if (p->unwinding || !expect(p, ';'))
+    return NULL;
+  node_lineno = lineno;
+  return attr(name, type, e);
+}
+
+// The features of a class, which may be none, up to its '}'.
+static Features parse_features(pratt *p)
+{
+  Features features = NULL;
+
+  if (peek(p) != OBJECTID) {
+    if (p->token != '}') {
+      syntax_error(p);
+      return NULL;
+    }
+    return nil_Features();
+  }
+  do {
+    Feature f = parse_feature(p);
+    if (p->unwinding)
+      return NULL;
+    features = features == NULL ? single_Features(f)
+				: extend_list(features, f);
+  } while (peek(p) == OBJECTID);
+  return features;
+}
+
+//
+// The body of a class, after its '{', through the '}' ';' that end the
+// class.  After an error the features start again after the next ';'.
+//
+static Features parse_class_body(pratt *p)
+{
+  Features features = parse_features(p);
+
+  for (;;) {
+    if (!p->unwinding) {
+      if (peek(p) == '}') {
+	shift(p);
+	if (peek(p) == ';') {
+	  shift(p);
+	  return features;
+	}
+      }
+      syntax_error(p);
+    }
+    do {                         // error ';' feature_list
+      if (p->aborted || !skip_to(p, ';', ';'))
+	return NULL;
+      shift(p);
+      features = parse_features(p);
+    } while (p->unwinding);
+    p->errstatus = 0;
+  }
+}
+
+// A class, from its CLASS through its ';'.
+static Class_ parse_class(pratt *p)
+{
+  parse_context *ctx = p->ctx;
+  int lineno = ctx->lineno;
+  Symbol name, parent = NULL;
+
+  shift(p);
+  name = expect_symbol(p, TYPEID);
+  if (p->unwinding)
+    return NULL;
+  if (peek(p) == INHERITS) {
+    shift(p);
+    parent = expect_symbol(p, TYPEID);
+    if (p->unwinding)
+      return NULL;
+  }
+  if (!expect(p, '{'))
+    return NULL;
+  Features features = parse_class_body(p);
+  if (p->unwinding)
+    return NULL;
+  node_lineno = lineno;
+  if (parent == NULL)
+    parent = idtable.add_string("Object");
+  return class_(name, parent, features, stringtable.add_string(ctx->filename));
+}
+
+//
+// The program, up to the end of the input.  After an error the classes
+// start again after the next ';': those before it are dropped, and
+// ctx->classes starts again from the next class.
+//
+static void parse_program(pratt *p)
+{
+  parse_context *ctx = p->ctx;
+  int recovering = 0;            // in error ';' class_list
+
+  for (;;) {
+    Classes classes = NULL;
+    peek(p);
+    int lineno = ctx->lineno;
+
+    do {
+      if (peek(p) != CLASS) {
+	syntax_error(p);
+	break;
+      }
+      Class_ c = parse_class(p);
+      if (p->unwinding)
+	break;
+      classes = classes == NULL ? single_Classes(c) : extend_list(classes, c);
+      ctx->classes = classes;
+    } while (peek(p) == CLASS);
+
+    if (!p->unwinding) {
+      if (recovering)
+	p->errstatus = 0;
+      node_lineno = lineno;
+      ctx->program = program(classes);
+      if (p->token == 0)
+	return;
+      syntax_error(p);
+    }
+    if (p->aborted || !skip_to(p, ';', ';'))
+      return;
+    shift(p);
+    recovering = 1;
+  }
+}
+
+int pratt_parse(parse_context *ctx)
+{
+  pratt p;
+
+  p.ctx = ctx;
+  p.have = 0;
+  p.token = 0;
+  p.errstatus = 0;
+  p.unwinding = 0;
+  p.aborted = 0;
+  p.depth = 0;
+  parse_program(&p);
+  return p.aborted;
+}
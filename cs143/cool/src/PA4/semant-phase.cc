@@ -1,11 +1,16 @@
 #include <stdio.h>
 #include "cool-tree.h"
+#include "utilities.h"   // for binary_ast
 
 extern Program ast_root;      // root of the abstract syntax tree
 FILE *ast_file = stdin;       // we read the AST from standard input
 extern int ast_yyparse(void); // entry point to the AST parser
+extern int binary_ast_input(FILE *in);    // is the AST in binary form?
+extern Program read_binary_ast(FILE *in); // reads a binary AST
 
 int cool_yydebug;     // not used, but needed to link with handle_flags
+extern int yy_flex_debug;     // for the AST scanner
+extern int cool_lex_debug;    //   set by -l
 int curr_lineno;
 char *curr_filename;
 
@@ -13,8 +18,15 @@ void handle_flags(int argc, char *argv[]);
 
 int main(int argc, char *argv[]) {
   handle_flags(argc,argv);
-  ast_yyparse();
+  yy_flex_debug = cool_lex_debug;
+  if (binary_ast_input(ast_file))
+    ast_root = read_binary_ast(ast_file);
+  else
+    ast_yyparse();
   ast_root->semant();
-  ast_root->dump_with_types(cout,0);
+  if (binary_ast)
+    ast_root->write_binary(stdout);
+  else
+    ast_root->dump_with_types(cout,0);
 }
 
@@ -0,0 +1,195 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  symtab_test.cc
+//
+//  Checks of SymbolTable and HashedSymbolTable (symtab.h): shadowing,
+//  probe and lookup as scopes are entered and exited, SymbolTable's
+//  snapshot and restore, and copies.  `make symtab_test' builds it; it
+//  prints each failed check and exits with status 1 if there were any.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <symtab.h>
+
+static int failures = 0;
+
+#define CHECK(cond)							\
+  if (!(cond)) {							\
+    cout << __FILE__ << ":" << __LINE__ << ": failed: " #cond "\n";	\
+    failures++;								\
+  }
+
+static char *Fred = "Fred";
+static char *Mary = "Mary";
+static char *Miguel = "Miguel";
+static int age22 = 22, age23 = 23, age25 = 25, age35 = 35;
+
+//
+// The checks that hold for both kinds of table.
+//
+template <class Table>
+static void check_scopes(Table &map)
+{
+  map.enterscope();
+  map.addid(Fred, &age22);
+  map.addid(Mary, &age25);
+
+  map.enterscope();
+  map.addid(Miguel, &age35);
+  map.addid(Mary, &age23);
+
+  // the inner Mary shadows the outer one
+  CHECK(map.lookup(Mary) == &age23);
+  CHECK(map.probe(Mary) == &age23);
+  CHECK(map.probe(Miguel) == &age35);
+  CHECK(map.probe(Fred) == NULL);
+  CHECK(map.lookup(Fred) == &age22);
+
+  // a symbol bound twice in one scope: the later binding wins, and
+  // both go with the scope
+  map.enterscope();
+  map.addid(Fred, &age35);
+  map.addid(Fred, &age23);
+  CHECK(map.lookup(Fred) == &age23);
+  map.exitscope();
+  CHECK(map.lookup(Fred) == &age22);
+
+  // after exitscope, probe sees only the outer scope
+  map.exitscope();
+  CHECK(map.lookup(Mary) == &age25);
+  CHECK(map.probe(Mary) == &age25);
+  CHECK(map.probe(Fred) == &age22);
+  CHECK(map.probe(Miguel) == NULL);
+  CHECK(map.lookup(Miguel) == NULL);
+
+  // a scope entered after one was exited starts empty
+  map.enterscope();
+  CHECK(map.probe(Mary) == NULL);
+  CHECK(map.probe(Miguel) == NULL);
+  CHECK(map.lookup(Mary) == &age25);
+  map.exitscope();
+  map.exitscope();
+  CHECK(map.lookup(Fred) == NULL);
+}
+
+//
+// Enough symbols, at addresses a word apart, that the hash table grows
+// several times and the scopes need several blocks and chunks.
+//
+template <class Table>
+static void check_many(Table &map)
+{
+  const int n = 5000;
+  int *keys = new int[n];
+
+  map.enterscope();
+  for (int i = 0; i < n; i += 2)
+    map.addid(&keys[i], &keys[i]);
+  map.enterscope();
+  for (int i = 0; i < n; i++)
+    map.addid(&keys[i], &keys[n - 1 - i]);
+  for (int i = 0; i < n; i++)
+    CHECK(map.probe(&keys[i]) == &keys[n - 1 - i]);
+  map.exitscope();
+  for (int i = 0; i < n; i++)
+    CHECK(map.lookup(&keys[i]) == (i % 2 == 0 ? &keys[i] : NULL));
+  map.exitscope();
+  delete [] keys;
+}
+
+//
+// Restoring a snapshot after the scopes it saw were exited, and others
+// entered and exited in their place, which reuses their memory unless
+// the snapshot pinned it.
+//
+static void check_snapshot()
+{
+  SymbolTable<char *, int> map;
+
+  map.enterscope();
+  map.addid(Fred, &age22);
+  map.enterscope();
+  map.addid(Mary, &age25);
+  SymbolTable<char *, int>::Snapshot s = map.snapshot();
+
+  map.exitscope();
+  map.exitscope();
+  for (int i = 0; i < 100; i++) {
+    map.enterscope();
+    for (int j = 0; j < 100; j++)
+      map.addid(Miguel, &age35);
+    map.exitscope();
+  }
+  CHECK(map.lookup(Fred) == NULL);
+
+  map.restore(s);
+  CHECK(map.lookup(Fred) == &age22);
+  CHECK(map.probe(Mary) == &age25);
+  CHECK(map.probe(Fred) == NULL);
+  CHECK(map.lookup(Miguel) == NULL);
+
+  // work on the restored table does not change the snapshot
+  map.addid(Miguel, &age35);
+  map.exitscope();
+  CHECK(map.probe(Fred) == &age22);
+  map.restore(s);
+  CHECK(map.lookup(Miguel) == NULL);
+  CHECK(map.lookup(Mary) == &age25);
+}
+
+//
+// A copy is not affected by later changes to the original, nor the
+// original by changes to the copy.
+//
+template <class Table>
+static void check_copy()
+{
+  Table map;
+  map.enterscope();
+  map.addid(Fred, &age22);
+  map.enterscope();
+  map.addid(Mary, &age25);
+
+  Table saved;
+  saved = map;
+  map.exitscope();
+  map.addid(Miguel, &age35);
+  CHECK(saved.probe(Mary) == &age25);
+  CHECK(saved.lookup(Fred) == &age22);
+  CHECK(saved.lookup(Miguel) == NULL);
+
+  saved.exitscope();
+  saved.addid(Mary, &age23);
+  CHECK(map.lookup(Mary) == NULL);
+  CHECK(map.lookup(Miguel) == &age35);
+}
+
+int main(int argc, char *argv[]) {
+  SymbolTable<char *, int> list_table;
+  HashedSymbolTable<char *, int> hashed_table;
+  SymbolTable<int *, int> list_many;
+  HashedSymbolTable<int *, int> hashed_many;
+
+  check_scopes(list_table);
+  check_scopes(hashed_table);
+  check_many(list_many);
+  check_many(hashed_many);
+  check_snapshot();
+  check_copy<SymbolTable<char *, int> >();
+  check_copy<HashedSymbolTable<char *, int> >();
+
+  if (failures != 0) {
+    cout << failures << " checks failed\n";
+    return 1;
+  }
+  cout << "symtab_test: all checks passed\n";
+  return 0;
+}
@@ -0,0 +1,119 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  token-ring.cc
+//
+//  Batched token delivery from the lexer to the parser (see
+//  token-ring.h).
+//
+//  The ring is indexed by running token counts, taken modulo SIZE: the
+//  lexer has written the tokens before tail, the parser has taken those
+//  before head, and the lexer may overwrite those before freed.  Only
+//  the lexer moves tail and only the parser moves head and freed, so
+//  each side keeps its own copy and takes the lock just to exchange
+//  them, once per batch.  A batch never wraps around the end of the
+//  ring, and the lexer stops after the end of its input.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "token-ring.h"
+
+TokenRing::TokenRing(cool_lexer *lx, int thr)
+  : lexer(lx), threaded(thr), tail(0), freed(0), stop(0), head(0), avail(0)
+{
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&filled, NULL);
+  pthread_cond_init(&drained, NULL);
+  if (threaded)
+    pthread_create(&thread, NULL, lexer_thread, this);
+}
+
+TokenRing::~TokenRing()
+{
+  if (threaded) {
+    pthread_mutex_lock(&lock);
+    stop = 1;
+    pthread_cond_signal(&drained);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+  }
+  pthread_cond_destroy(&drained);
+  pthread_cond_destroy(&filled);
+  pthread_mutex_destroy(&lock);
+}
+
+//
+// Lex a batch into the ring at pos and return its size.  The batch is
+// cut short by the end of the ring or of the input.
+//
+int TokenRing::lex_batch(unsigned long pos)
+{
+  int i = pos & (SIZE - 1);
+  int n = SIZE - i;
+  if (n > BATCH)
+    n = BATCH;
+  for (lexed_token *t = &ring[i], *end = t + n; t < end; t++) {
+    t->token = cool_lexer_token(lexer);
+    t->lval = lexer->lval;
+    t->lineno = lexer->lineno;
+    if (t->token == 0)
+      return t - &ring[i] + 1;
+  }
+  return n;
+}
+
+//
+// Called by next() when the parser has taken every token it knows of.
+// Without a thread, lex the next batch here; otherwise give the lexer
+// the room the parser has made, and wait for its next batch.
+//
+void TokenRing::refill()
+{
+  if (!threaded) {
+    tail += lex_batch(tail);
+    avail = tail;
+    return;
+  }
+  pthread_mutex_lock(&lock);
+  freed = head;
+  pthread_cond_signal(&drained);
+  while (tail == head)
+    pthread_cond_wait(&filled, &lock);
+  avail = tail;
+  pthread_mutex_unlock(&lock);
+}
+
+void TokenRing::run_lexer()
+{
+  unsigned long pos = 0;
+  int done;
+
+  do {
+    pthread_mutex_lock(&lock);
+    while (!stop && pos + BATCH - freed > SIZE)
+      pthread_cond_wait(&drained, &lock);
+    done = stop;
+    pthread_mutex_unlock(&lock);
+    if (done)
+      break;
+
+    pos += lex_batch(pos);
+    done = ring[(pos - 1) & (SIZE - 1)].token == 0;
+
+    pthread_mutex_lock(&lock);
+    tail = pos;
+    pthread_cond_signal(&filled);
+    pthread_mutex_unlock(&lock);
+  } while (!done);
+}
+
+void *TokenRing::lexer_thread(void *r)
+{
+  ((TokenRing *) r)->run_lexer();
+  return NULL;
+}
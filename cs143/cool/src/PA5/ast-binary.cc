@@ -0,0 +1,912 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  ast-binary.cc
+//
+//  A binary form of the AST, for passing the tree between the phases
+//  without printing it and parsing it again.  With the -B flag, a phase
+//  writes its AST with Program_class::write_binary instead of
+//  dump_with_types; the phases that read an AST accept either form.
+//
+//  The stream is
+//
+//      "COOLAST" version         8 bytes; the version is '1'
+//      size                      4 bytes, little endian: the size of the tree
+//      tree                      size bytes
+//      string tables             as written by write_string_tables
+//
+//  The tree is the nodes in preorder.  Each node is a tag byte and its
+//  line number, followed by its fields in the order of cool-tree.aps;
+//  an expression ends with its type.  Line numbers, list lengths and
+//  symbols are unsigned LEB128 varints.  A symbol is its index in the
+//  table that the field belongs to, plus one; 0 is a NULL symbol (the
+//  type of an expression that has not been checked).  Booleans are one
+//  byte.
+//
+//  The string tables follow the tree, so that a writer need not know
+//  every symbol before it starts, but a reader must load them before it
+//  can build the nodes; read_binary_ast therefore reads the tree into a
+//  buffer first.
+//
+//  A single class can also be written on its own, for coolc's class
+//  cache (see class-cache.cc), with the symbols it uses instead of the
+//  string tables:
+//
+//      "COOLCLS" version         8 bytes; the version is '3'
+//      size                      4 bytes, little endian: the size of the rest
+//      check                     4 bytes, little endian: the check of the rest
+//      text                      its length, then the source of the class
+//      lineno                    the line number of the class's first token
+//      symbols                   their number, then each one spelled out
+//      class                     the class node, as in the tree above
+//
+//  The class is read back only if its source is the same text, byte for
+//  byte, and the check matches, so that neither a cache entry for other
+//  text nor one damaged on disk can stand in for a parse.  A symbol in
+//  the class is its index in the class's symbols, plus one.  Each of
+//  the class's symbols is written once, as its length and then its
+//  characters, and interned when the class is read back, the first time
+//  the class uses it.  Every line number read back is moved by the
+//  difference between the class's first line then and now.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>  // for fstat
+#include "cool-tree.h"
+#include "utilities.h"
+
+static const char ast_magic[7] = { 'C', 'O', 'O', 'L', 'A', 'S', 'T' };
+#define AST_VERSION '1'
+static const char class_magic[7] = { 'C', 'O', 'O', 'L', 'C', 'L', 'S' };
+#define CLASS_VERSION '3'
+
+enum ast_tag {
+  AST_program = 1, AST_class_, AST_method, AST_attr, AST_formal, AST_branch,
+  AST_assign, AST_static_dispatch, AST_dispatch, AST_cond, AST_loop,
+  AST_typcase, AST_block, AST_let, AST_plus, AST_sub, AST_mul, AST_divide,
+  AST_neg, AST_lt, AST_eq, AST_leq, AST_comp, AST_int_const, AST_bool_const,
+  AST_string_const, AST_new_, AST_isvoid, AST_no_expr, AST_object
+};
+
+//
+// Sizes and checks are 4 bytes, little endian.
+//
+static void write_word(unsigned int n, FILE *f)
+{
+  for (int i = 0; i < 4; i++)
+    putc((n >> (8 * i)) & 0xff, f);
+}
+
+static unsigned int read_word(unsigned char *p)
+{
+  unsigned int n = 0;
+  for (int i = 0; i < 4; i++)
+    n |= (unsigned int) p[i] << (8 * i);
+  return n;
+}
+
+//
+// The check of a class written on its own: FNV-1a (see hash_string in
+// stringtab.cc) a word at a time, with the high bits folded down after
+// each.  Any change to one byte changes it, and it is cheap next to
+// reading the class back.
+//
+static unsigned int check_bytes(unsigned char *p, unsigned int n)
+{
+  unsigned int h = 2166136261u;
+  for (; n >= 4; p += 4, n -= 4) {
+    h = (h ^ read_word(p)) * 16777619u;
+    h ^= h >> 16;
+  }
+  for (; n > 0; p++, n--) {
+    h = (h ^ *p) * 16777619u;
+    h ^= h >> 16;
+  }
+  return h;
+}
+
+//
+// ast_writer collects the encoded tree in a growing buffer.  For a
+// class on its own, it also numbers the symbols as it meets them, and
+// finds them again through an open hash table.
+//
+class ast_writer {
+private:
+  unsigned char *buf;
+  int size;
+  int cap;
+  Symbol *local;                 // the class's symbols, or NULL
+  int nlocal;
+  int *slots;                    // index + 1 of a symbol in local, or 0
+  int nslots;                    // a power of 2, more than 2 * nlocal
+
+  void grow(int n)
+  {
+    while (size + n > cap) {
+      unsigned char *bigger = new unsigned char[2 * cap];
+      memcpy(bigger, buf, size);
+      delete [] buf;
+      buf = bigger;
+      cap *= 2;
+    }
+  }
+
+  int slot(Symbol s)
+  {
+    int i = s->get_hash() & (nslots - 1);
+    while (slots[i] != 0 && local[slots[i] - 1] != s)
+      i = (i + 1) & (nslots - 1);
+    return i;
+  }
+
+  void grow_local()
+  {
+    Symbol *bigger = new Symbol[nslots];
+    memcpy(bigger, local, nlocal * sizeof(Symbol));
+    delete [] local;
+    local = bigger;
+    delete [] slots;
+    nslots *= 2;
+    slots = new int[nslots];
+    memset(slots, 0, nslots * sizeof(int));
+    for (int i = 0; i < nlocal; i++)
+      slots[slot(local[i])] = i + 1;
+  }
+
+  int local_index(Symbol s)
+  {
+    int i = slot(s);
+    if (slots[i] != 0)
+      return slots[i] - 1;
+    if (2 * (nlocal + 1) >= nslots) {
+      grow_local();
+      i = slot(s);
+    }
+    local[nlocal] = s;
+    slots[i] = ++nlocal;
+    return nlocal - 1;
+  }
+public:
+  ast_writer() : size(0), cap(4096), local(NULL), nlocal(0), slots(NULL),
+		 nslots(0) { buf = new unsigned char[cap]; }
+  ~ast_writer()
+  {
+    delete [] buf;
+    delete [] local;
+    delete [] slots;
+  }
+
+  // Number the symbols of a class on its own, rather than use their
+  // indexes in the string tables.
+  void class_symbols()
+  {
+    nslots = 256;
+    slots = new int[nslots];
+    memset(slots, 0, nslots * sizeof(int));
+    local = new Symbol[nslots / 2];
+  }
+
+  void byte(int b) { grow(1); buf[size++] = b; }
+  void varint(unsigned int n)
+  {
+    grow(5);
+    while (n >= 0x80) {
+      buf[size++] = (n & 0x7f) | 0x80;
+      n >>= 7;
+    }
+    buf[size++] = n;
+  }
+  void node(int tag, int lineno) { byte(tag); varint(lineno); }
+  void symbol(Symbol s)
+  {
+    if (s == NULL)
+      varint(0);
+    else
+      varint((local ? local_index(s) : s->get_index()) + 1);
+  }
+
+  void bytes(unsigned char *p, int n)
+  {
+    grow(n);
+    memcpy(buf + size, p, n);
+    size += n;
+  }
+
+  void chars(char *s, int n)
+  {
+    varint(n);
+    bytes((unsigned char *) s, n);
+  }
+
+  // Write w's symbols, and then its tree, to this writer.
+  void append_class(ast_writer& w)
+  {
+    varint(w.nlocal);
+    for (int i = 0; i < w.nlocal; i++)
+      chars(w.local[i]->get_string(), w.local[i]->get_len());
+    bytes(w.buf, w.size);
+  }
+
+  // Write the size of the buffer, and then the buffer; with check, the
+  // check_bytes of the buffer goes between them.
+  void write(FILE *f, int check = 0)
+  {
+    write_word(size, f);
+    if (check)
+      write_word(check_bytes(buf, size), f);
+    fwrite(buf, 1, size, f);
+  }
+};
+
+template <class Elem>
+static void dump_binary_list(ast_writer& w, list_node<Elem> *l)
+{
+  w.varint(l->len());
+  for (int i = l->first(); l->more(i); i = l->next(i))
+    l->nth(i)->dump_binary(w);
+}
+
+void Program_class::write_binary(FILE *f)
+{
+  ast_writer w;
+  dump_binary(w);
+  fwrite(ast_magic, 1, sizeof(ast_magic), f);
+  putc(AST_VERSION, f);
+  w.write(f);
+  write_string_tables(f);
+  fflush(f);
+}
+
+//
+// write_binary_class writes c, which was parsed from the len bytes at
+// text, whose first token is on line lineno.
+//
+void write_binary_class(Class_ c, char *text, int len, int lineno, FILE *f)
+{
+  ast_writer tree, w;
+  tree.class_symbols();
+  c->dump_binary(tree);
+  w.chars(text, len);
+  w.varint(lineno);
+  w.append_class(tree);
+  fwrite(class_magic, 1, sizeof(class_magic), f);
+  putc(CLASS_VERSION, f);
+  w.write(f, 1);
+}
+
+//
+// The writers, one for each kind of node.
+//
+void program_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_program, line_number);
+  dump_binary_list(w, classes);
+}
+
+void class__class::dump_binary(ast_writer& w)
+{
+  w.node(AST_class_, line_number);
+  w.symbol(name);
+  w.symbol(parent);
+  dump_binary_list(w, features);
+  w.symbol(filename);
+}
+
+void method_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_method, line_number);
+  w.symbol(name);
+  dump_binary_list(w, formals);
+  w.symbol(return_type);
+  expr->dump_binary(w);
+}
+
+void attr_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_attr, line_number);
+  w.symbol(name);
+  w.symbol(type_decl);
+  init->dump_binary(w);
+}
+
+void formal_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_formal, line_number);
+  w.symbol(name);
+  w.symbol(type_decl);
+}
+
+void branch_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_branch, line_number);
+  w.symbol(name);
+  w.symbol(type_decl);
+  expr->dump_binary(w);
+}
+
+void assign_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_assign, line_number);
+  w.symbol(name);
+  expr->dump_binary(w);
+  w.symbol(type);
+}
+
+void static_dispatch_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_static_dispatch, line_number);
+  expr->dump_binary(w);
+  w.symbol(type_name);
+  w.symbol(name);
+  dump_binary_list(w, actual);
+  w.symbol(type);
+}
+
+void dispatch_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_dispatch, line_number);
+  expr->dump_binary(w);
+  w.symbol(name);
+  dump_binary_list(w, actual);
+  w.symbol(type);
+}
+
+void cond_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_cond, line_number);
+  pred->dump_binary(w);
+  then_exp->dump_binary(w);
+  else_exp->dump_binary(w);
+  w.symbol(type);
+}
+
+void loop_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_loop, line_number);
+  pred->dump_binary(w);
+  body->dump_binary(w);
+  w.symbol(type);
+}
+
+void typcase_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_typcase, line_number);
+  expr->dump_binary(w);
+  dump_binary_list(w, cases);
+  w.symbol(type);
+}
+
+void block_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_block, line_number);
+  dump_binary_list(w, body);
+  w.symbol(type);
+}
+
+void let_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_let, line_number);
+  w.symbol(identifier);
+  w.symbol(type_decl);
+  init->dump_binary(w);
+  body->dump_binary(w);
+  w.symbol(type);
+}
+
+#define DUMP_BINARY_BINOP(op)				\
+void op##_class::dump_binary(ast_writer& w)		\
+{							\
+  w.node(AST_##op, line_number);			\
+  e1->dump_binary(w);					\
+  e2->dump_binary(w);					\
+  w.symbol(type);					\
+}
+
+#define DUMP_BINARY_UNOP(op)				\
+void op##_class::dump_binary(ast_writer& w)		\
+{							\
+  w.node(AST_##op, line_number);			\
+  e1->dump_binary(w);					\
+  w.symbol(type);					\
+}
+
+DUMP_BINARY_BINOP(plus)
+DUMP_BINARY_BINOP(sub)
+DUMP_BINARY_BINOP(mul)
+DUMP_BINARY_BINOP(divide)
+DUMP_BINARY_UNOP(neg)
+DUMP_BINARY_BINOP(lt)
+DUMP_BINARY_BINOP(eq)
+DUMP_BINARY_BINOP(leq)
+DUMP_BINARY_UNOP(comp)
+DUMP_BINARY_UNOP(isvoid)
+
+void int_const_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_int_const, line_number);
+  w.symbol(token);
+  w.symbol(type);
+}
+
+void bool_const_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_bool_const, line_number);
+  w.byte(val != 0);
+  w.symbol(type);
+}
+
+void string_const_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_string_const, line_number);
+  w.symbol(token);
+  w.symbol(type);
+}
+
+void new__class::dump_binary(ast_writer& w)
+{
+  w.node(AST_new_, line_number);
+  w.symbol(type_name);
+  w.symbol(type);
+}
+
+void no_expr_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_no_expr, line_number);
+  w.symbol(type);
+}
+
+void object_class::dump_binary(ast_writer& w)
+{
+  w.node(AST_object, line_number);
+  w.symbol(name);
+  w.symbol(type);
+}
+
+//
+// ast_reader builds the nodes through the usual constructors.  The
+// children of a node are read before it is made, so each reader keeps
+// its node's line number and sets node_lineno just before the
+// constructor runs.
+//
+extern __thread int node_lineno;
+
+class ast_reader {
+private:
+  unsigned char *p;
+  unsigned char *end;
+  Symbol *local;                 // a class's own symbols, or NULL
+  char **spelling;               //   until they are interned
+  int *spelled_len;
+  unsigned int nlocal;
+  int line_delta;                // added to every line number
+  int quiet;                     // on bad input, set bad instead of exiting
+  int bad;                       //   and read on as if the input ended
+
+  void error(char *msg)
+  {
+    if (!quiet)
+      fatal_error(msg);
+    bad = 1;
+    p = end;
+  }
+
+  void truncated() { error("Truncated binary AST\n"); }
+
+  int byte()
+  {
+    if (p == end) {
+      truncated();
+      return 0;
+    }
+    return *p++;
+  }
+
+  unsigned int varint()
+  {
+    unsigned int n = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      int b = byte();
+      n |= (unsigned int) (b & 0x7f) << shift;
+      if ((b & 0x80) == 0)
+	return n;
+    }
+    error("Bad varint in binary AST\n");
+    return 0;
+  }
+
+  // The length of a list.  Each element takes at least a byte, so a
+  // list longer than the bytes left is bad.
+  unsigned int count()
+  {
+    unsigned int n = varint();
+    if (n > (unsigned int) (end - p)) {
+      truncated();
+      return 0;
+    }
+    return n;
+  }
+
+  template <class Elem>
+  Elem *symbol(StringTable<Elem>& table)
+  {
+    unsigned int i = varint();
+    if (i == 0)
+      return NULL;
+    if (local) {
+      if (i > nlocal) {
+	error("Bad symbol in binary class\n");
+	return NULL;
+      }
+      if (local[i - 1] == NULL)
+	local[i - 1] = table.add_chars(spelling[i - 1], spelled_len[i - 1]);
+      return (Elem *) local[i - 1];
+    }
+    if (!table.more(i - 1)) {
+      error("Bad symbol in binary AST\n");
+      return NULL;
+    }
+    return table.lookup(i - 1);
+  }
+
+  Symbol id()     { return symbol(idtable); }
+  Symbol number() { return symbol(inttable); }
+  Symbol string() { return symbol(stringtable); }
+
+  int line() { return varint() + line_delta; }
+
+  int node(int tag)
+  {
+    if (byte() != tag)
+      error("Unexpected node in binary AST\n");
+    return line();
+  }
+
+  Expression typed(Expression e, Symbol type)
+  {
+    e->set_type(type);
+    return e;
+  }
+
+public:
+  ast_reader(unsigned char *start, unsigned char *stop)
+    : p(start), end(stop), local(NULL), spelling(NULL), spelled_len(NULL),
+      nlocal(0), line_delta(0), quiet(0), bad(0) { }
+  ~ast_reader()
+  {
+    delete [] local;
+    delete [] spelling;
+    delete [] spelled_len;
+  }
+
+  int done() { return p == end && !bad; }
+
+  // Read the head of a class written on its own, which must have been
+  // parsed from the len bytes at text, and now starts on line lineno.
+  // Such a class comes from coolc's cache, and is parsed again if it is
+  // bad, so from here on bad input only sets bad.
+  void read_class_head(char *text, int len, int lineno)
+  {
+    quiet = 1;
+    unsigned int n = varint();
+    if (n != (unsigned int) len || n > (unsigned int) (end - p) ||
+	memcmp(p, text, len) != 0) {
+      error("Class from other text in binary class\n");
+      return;
+    }
+    p += n;
+    line_delta = lineno - varint();
+    nlocal = count();
+    local = new Symbol[nlocal];
+    spelling = new char *[nlocal];
+    spelled_len = new int[nlocal];
+    for (unsigned int i = 0; i < nlocal; i++) {
+      unsigned int n = varint();
+      if (n > (unsigned int) (end - p)) {
+	nlocal = i;
+	truncated();
+	return;
+      }
+      local[i] = NULL;
+      spelling[i] = (char *) p;
+      spelled_len[i] = n;
+      p += n;
+    }
+  }
+
+  Program read_program();
+  Class_ read_class();
+  Feature read_feature();
+  Formal read_formal();
+  Case read_case();
+  Expression read_expression();
+  Expressions read_expressions();
+};
+
+Program ast_reader::read_program()
+{
+  int lineno = node(AST_program);
+  Classes classes = nil_Classes();
+  for (unsigned int n = count(); n > 0 && !bad; n--)
+    classes = extend_list(classes, read_class());
+  node_lineno = lineno;
+  return program(classes);
+}
+
+Class_ ast_reader::read_class()
+{
+  int lineno = node(AST_class_);
+  Symbol name = id();
+  Symbol parent = id();
+  Features features = nil_Features();
+  for (unsigned int n = count(); n > 0 && !bad; n--)
+    features = extend_list(features, read_feature());
+  Symbol filename = string();
+  node_lineno = lineno;
+  return class_(name, parent, features, filename);
+}
+
+Feature ast_reader::read_feature()
+{
+  int tag = byte();
+  int lineno = line();
+  Symbol name = id();
+
+  if (tag == AST_method) {
+    Formals formals = nil_Formals();
+    for (unsigned int n = count(); n > 0 && !bad; n--)
+      formals = extend_list(formals, read_formal());
+    Symbol return_type = id();
+    Expression expr = read_expression();
+    node_lineno = lineno;
+    return method(name, formals, return_type, expr);
+  }
+  if (tag != AST_attr)
+    error("Unexpected node in binary AST\n");
+  Symbol type_decl = id();
+  Expression init = read_expression();
+  node_lineno = lineno;
+  return attr(name, type_decl, init);
+}
+
+Formal ast_reader::read_formal()
+{
+  int lineno = node(AST_formal);
+  Symbol name = id();
+  Symbol type_decl = id();
+  node_lineno = lineno;
+  return formal(name, type_decl);
+}
+
+Case ast_reader::read_case()
+{
+  int lineno = node(AST_branch);
+  Symbol name = id();
+  Symbol type_decl = id();
+  Expression expr = read_expression();
+  node_lineno = lineno;
+  return branch(name, type_decl, expr);
+}
+
+Expressions ast_reader::read_expressions()
+{
+  Expressions l = nil_Expressions();
+  for (unsigned int n = count(); n > 0 && !bad; n--)
+    l = extend_list(l, read_expression());
+  return l;
+}
+
+Expression ast_reader::read_expression()
+{
+  int tag = byte();
+  int lineno = line();
+  Expression e1, e2, e3;
+  Symbol s1, s2;
+  Boolean b;
+  Expressions actual;
+  Cases cases;
+  Expression e;
+
+  switch (tag) {
+  case AST_assign:
+    s1 = id();
+    e1 = read_expression();
+    node_lineno = lineno;
+    e = assign(s1, e1);
+    break;
+  case AST_static_dispatch:
+    e1 = read_expression();
+    s1 = id();
+    s2 = id();
+    actual = read_expressions();
+    node_lineno = lineno;
+    e = static_dispatch(e1, s1, s2, actual);
+    break;
+  case AST_dispatch:
+    e1 = read_expression();
+    s1 = id();
+    actual = read_expressions();
+    node_lineno = lineno;
+    e = dispatch(e1, s1, actual);
+    break;
+  case AST_cond:
+    e1 = read_expression();
+    e2 = read_expression();
+    e3 = read_expression();
+    node_lineno = lineno;
+    e = cond(e1, e2, e3);
+    break;
+  case AST_loop:
+    e1 = read_expression();
+    e2 = read_expression();
+    node_lineno = lineno;
+    e = loop(e1, e2);
+    break;
+  case AST_typcase:
+    e1 = read_expression();
+    cases = nil_Cases();
+    for (unsigned int n = count(); n > 0 && !bad; n--)
+      cases = extend_list(cases, read_case());
+    node_lineno = lineno;
+    e = typcase(e1, cases);
+    break;
+  case AST_block:
+    actual = read_expressions();
+    node_lineno = lineno;
+    e = block(actual);
+    break;
+  case AST_let:
+    s1 = id();
+    s2 = id();
+    e1 = read_expression();
+    e2 = read_expression();
+    node_lineno = lineno;
+    e = let(s1, s2, e1, e2);
+    break;
+  case AST_plus:
+  case AST_sub:
+  case AST_mul:
+  case AST_divide:
+  case AST_lt:
+  case AST_eq:
+  case AST_leq:
+    e1 = read_expression();
+    e2 = read_expression();
+    node_lineno = lineno;
+    switch (tag) {
+    case AST_plus:   e = plus(e1, e2); break;
+    case AST_sub:    e = sub(e1, e2); break;
+    case AST_mul:    e = mul(e1, e2); break;
+    case AST_divide: e = divide(e1, e2); break;
+    case AST_lt:     e = lt(e1, e2); break;
+    case AST_eq:     e = eq(e1, e2); break;
+    default:         e = leq(e1, e2); break;
+    }
+    break;
+  case AST_neg:
+  case AST_comp:
+  case AST_isvoid:
+    e1 = read_expression();
+    node_lineno = lineno;
+    switch (tag) {
+    case AST_neg:  e = neg(e1); break;
+    case AST_comp: e = comp(e1); break;
+    default:       e = isvoid(e1); break;
+    }
+    break;
+  case AST_int_const:
+    s1 = number();
+    node_lineno = lineno;
+    e = int_const(s1);
+    break;
+  case AST_bool_const:
+    b = byte();
+    node_lineno = lineno;
+    e = bool_const(b);
+    break;
+  case AST_string_const:
+    s1 = string();
+    node_lineno = lineno;
+    e = string_const(s1);
+    break;
+  case AST_new_:
+    s1 = id();
+    node_lineno = lineno;
+    e = new_(s1);
+    break;
+  case AST_no_expr:
+    node_lineno = lineno;
+    e = no_expr();
+    break;
+  case AST_object:
+    s1 = id();
+    node_lineno = lineno;
+    e = object(s1);
+    break;
+  default:
+    error("Unexpected node in binary AST\n");
+    return NULL;
+  }
+  return typed(e, id());
+}
+
+//
+// binary_ast_input peeks at in and says whether it holds a binary AST
+// rather than the text form, which always begins with '#'.
+//
+int binary_ast_input(FILE *in)
+{
+  int c = getc(in);
+  if (c == EOF)
+    return 0;
+  ungetc(c, in);
+  return c == ast_magic[0];
+}
+
+Program read_binary_ast(FILE *in)
+{
+  unsigned char header[sizeof(ast_magic) + 5];
+  if (fread(header, 1, sizeof(header), in) != sizeof(header) ||
+      memcmp(header, ast_magic, sizeof(ast_magic)) != 0)
+    fatal_error("Input is not a binary AST\n");
+  if (header[sizeof(ast_magic)] != AST_VERSION)
+    fatal_error("Unsupported binary AST version\n");
+
+  unsigned int size = read_word(header + sizeof(ast_magic) + 1);
+  unsigned char *tree = new unsigned char[size];
+  if (fread(tree, 1, size, in) != size)
+    fatal_error("Truncated binary AST\n");
+  if (!read_string_tables(in))
+    fatal_error("Bad string tables in binary AST\n");
+
+  ast_reader r(tree, tree + size);
+  Program p = r.read_program();
+  if (!r.done())
+    fatal_error("Trailing bytes in binary AST\n");
+  delete [] tree;
+  return p;
+}
+
+//
+// read_binary_class reads a class written by write_binary_class, which
+// must have been parsed from the len bytes at text, and whose first
+// token is now on line lineno.  It returns NULL if f does not hold a
+// class in this version of the format, or holds one parsed from other
+// text, or if the class is damaged.  f must be a whole file, as its
+// size is checked before the class is read.
+//
+Class_ read_binary_class(FILE *f, char *text, int len, int lineno)
+{
+  unsigned char header[sizeof(class_magic) + 9];
+  if (fread(header, 1, sizeof(header), f) != sizeof(header) ||
+      memcmp(header, class_magic, sizeof(class_magic)) != 0 ||
+      header[sizeof(class_magic)] != CLASS_VERSION)
+    return NULL;
+
+  unsigned int size = read_word(header + sizeof(class_magic) + 1);
+  unsigned int check = read_word(header + sizeof(class_magic) + 5);
+  struct stat st;
+  if (fstat(fileno(f), &st) != 0 ||
+      st.st_size != (off_t) (sizeof(header) + size))
+    return NULL;
+
+  unsigned char *tree = new unsigned char[size];
+  if (fread(tree, 1, size, f) != size ||
+      check_bytes(tree, size) != check) {
+    delete [] tree;
+    return NULL;
+  }
+  ast_reader r(tree, tree + size);
+  r.read_class_head(text, len, lineno);
+  Class_ c = r.read_class();
+  if (!r.done())
+    c = NULL;
+  delete [] tree;
+  return c;
+}
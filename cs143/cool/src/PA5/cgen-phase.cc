@@ -10,8 +10,12 @@ extern char *out_filename;    // name of output assembly
 extern Program ast_root;             // root of the abstract syntax tree
 FILE *ast_file = stdin;       // we read the AST from standard input
 extern int ast_yyparse(void); // entry point to the AST parser
+extern int binary_ast_input(FILE *in);    // is the AST in binary form?
+extern Program read_binary_ast(FILE *in); // reads a binary AST
 
 int cool_yydebug;     // not used, but needed to link with handle_flags
+extern int yy_flex_debug;     // for the AST scanner
+extern int cool_lex_debug;    //   set by -l
 int curr_lineno;
 char *curr_filename;
 
@@ -21,6 +25,7 @@ int main(int argc, char *argv[]) {
   int firstfile_index;
 
   handle_flags(argc,argv);
+  yy_flex_debug = cool_lex_debug;
   firstfile_index = optind;
 
   if (!out_filename && optind < argc) {   // no -o option
@@ -35,7 +40,10 @@ int main(int argc, char *argv[]) {
   // Don't touch the output file until we know that earlier phases of the
   // compiler have succeeded.
   //
-  ast_yyparse();
+  if (binary_ast_input(ast_file))
+    ast_root = read_binary_ast(ast_file);
+  else
+    ast_yyparse();
 
   if (out_filename) {
       ofstream s(out_filename);
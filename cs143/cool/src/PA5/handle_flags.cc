@@ -18,13 +18,21 @@
 // All flags that can be set on the command line should be defined here;
 // otherwise, it is necessary to pollute test drivers for components of the
 // compiler with declarations of extern'ed debugging flags to satisfy the
-// linker.  The exceptions to this rule are yy_flex_debug and cool_yydebug, 
-// which are defined in files generated by flex and bison.
+// linker.  The exception to this rule is cool_yydebug, which is defined
+// in the file generated by bison.  The phases that read tokens or an AST
+// with a scanner of their own copy cool_lex_debug into its yy_flex_debug.
 //
 
-extern int yy_flex_debug;       // for the lexer; prints recognized rules
+       int cool_lex_debug;      // for the lexer; prints recognized rules
 extern int cool_yydebug;        // for the parser
        int lex_verbose;         // also for the lexer; prints tokens
+       int binary_tokens;       // lexer and parser use binary token streams
+       int binary_ast;          // phases write the binary AST
+       int mmap_input;          // the lexer scans mapped source files
+       int lex_threads;         // number of files lexed at once
+       int pratt_parser;        // parse with the hand-written parser
+       char *class_cache;       // coolc reuses unchanged classes from here
+       int parser_stats;        // the parser counts what it does
        int semant_debug;        // for semantic analysis
        int cgen_debug;          // for code gen
        bool disable_reg_alloc;  // Don't do register allocation
@@ -44,20 +52,27 @@ void handle_flags(int argc, char *argv[]) {
   int unknownopt = 0;
 
   // no debugging or optimization by default
-  yy_flex_debug = 0;
+  cool_lex_debug = 0;
   cool_yydebug = 0;
   lex_verbose  = 0;
   semant_debug = 0;
   cgen_debug = 0;
   cgen_optimize = 0;
   disable_reg_alloc = 0;
+  binary_tokens = 0;
+  binary_ast = 0;
+  mmap_input = 0;
+  lex_threads = 1;
+  pratt_parser = 0;
+  class_cache = NULL;
+  parser_stats = 0;
   
 
-  while ((c = getopt(argc, argv, "lpscvrOo:gtT")) != -1) {
+  while ((c = getopt(argc, argv, "lpscvrbBmPSj:i:Oo:gtT")) != -1) {
     switch (c) {
 #ifdef DEBUG
     case 'l':
-      yy_flex_debug = 1;
+      cool_lex_debug = 1;
       break;
     case 'p':
       cool_yydebug = 1;
@@ -99,6 +114,29 @@ void handle_flags(int argc, char *argv[]) {
     case 'O':  // enable optimization
       cgen_optimize = 1;
       break;
+    case 'b':  // binary token stream between lexer and parser
+      binary_tokens = 1;
+      break;
+    case 'B':  // binary AST between the later phases
+      binary_ast = 1;
+      break;
+    case 'm':  // lexer scans source files in place
+      mmap_input = 1;
+      break;
+    case 'P':  // parse with the hand-written parser, not bison's
+      pratt_parser = 1;
+      break;
+    case 'S':  // the parser phase prints statistics of the parse
+      parser_stats = 1;
+      break;
+    case 'i':  // coolc parses only the classes not cached in this directory
+      class_cache = optarg;
+      break;
+    case 'j':  // lex (and in coolc, parse) this many files at once
+      lex_threads = atoi(optarg);
+      if (lex_threads < 1)
+	unknownopt = 1;
+      break;
     case '?':
       unknownopt = 1;
       break;
@@ -111,9 +149,9 @@ void handle_flags(int argc, char *argv[]) {
   if (unknownopt) {
       cerr << "usage: " << argv[0] << 
 #ifdef DEBUG
-	  " [-lvpscOgtTr -o outname] [input-files]\n";
+	  " [-lvpscbBmPSOgtTr -j threads -i cache -o outname] [input-files]\n";
 #else
-      " [-OgtT -o outname] [input-files]\n";
+      " [-bBmPSOgtT -j threads -i cache -o outname] [input-files]\n";
 #endif
       exit(1);
   }
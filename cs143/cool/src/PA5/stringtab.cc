@@ -5,6 +5,8 @@
 #include "copyright.h"
 
 #include <assert.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "stringtab_functions.h"
 #include "stringtab.h"
 
@@ -22,6 +24,30 @@ Entry::Entry(char *s, int l, int i) : len(l), index(i) {
   str = new char [len+1];
   strncpy(str, s, len);
   str[len] = '\0';
+  hash = hash_string(str, len);
+}
+
+Entry::Entry(char *s, int l, int i, char *buf) : len(l), index(i) {
+  str = buf;
+  if (buf != s) {
+    strncpy(str, s, len);
+    str[len] = '\0';
+  }
+  hash = hash_string(str, len);
+}
+
+//
+// 32-bit FNV-1a.  Cheap to compute and spreads short identifiers well,
+// which matters because the tables index by the low bits only.
+//
+unsigned int hash_string(char *s, int len)
+{
+  unsigned int h = 2166136261u;
+  for (int i = 0; i < len; i++) {
+    h ^= (unsigned char) s[i];
+    h *= 16777619u;
+  }
+  return h;
 }
 
 int Entry::equal_string(char *string, int length) const
@@ -74,6 +100,127 @@ StringEntry::StringEntry(char *s, int l, int i) : Entry(s,l,i) { }
 IdEntry::IdEntry(char *s, int l, int i) : Entry(s,l,i) { }
 IntEntry::IntEntry(char *s, int l, int i) : Entry(s,l,i) { }
 
+StringEntry::StringEntry(char *s, int l, int i, char *buf) : Entry(s,l,i,buf) { }
+IdEntry::IdEntry(char *s, int l, int i, char *buf) : Entry(s,l,i,buf) { }
+IntEntry::IntEntry(char *s, int l, int i, char *buf) : Entry(s,l,i,buf) { }
+
+int stringtab_allocs = 0;
+
+//
+// StringArena::new_chunk starts a fresh chunk large enough for a request
+// of size bytes.  Whatever is left of the old chunk is abandoned.
+//
+void StringArena::new_chunk(int size)
+{
+  int chunk = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+  next = new char[chunk];
+  limit = next + chunk;
+  COUNT_STRINGTAB_ALLOC();
+}
+
 IdTable idtable;
 IntTable inttable;
 StrTable stringtable;
+
+//
+// A front end that interns symbols from several threads brackets that
+// work with these two calls.
+//
+void begin_concurrent_interning()
+{
+  idtable.begin_concurrent();
+  inttable.begin_concurrent();
+  stringtable.begin_concurrent();
+}
+
+void canonicalize_interning()
+{
+  idtable.canonicalize();
+  inttable.canonicalize();
+  stringtable.canonicalize();
+}
+
+
+//
+// String table files.  A file holds a header
+//
+//    char   magic[8]       "COOLSTR1"
+//
+// followed by one section (see StringTable::write_binary) for each of
+// idtable, inttable and stringtable, in that order.  A phase that finds
+// the file mapped in memory can use the strings in it without copying.
+//
+static char stringtab_magic[8] = { 'C','O','O','L','S','T','R','1' };
+
+void write_string_tables(FILE *f)
+{
+  fwrite(stringtab_magic, 1, sizeof(stringtab_magic), f);
+  idtable.write_binary(f);
+  inttable.write_binary(f);
+  stringtable.write_binary(f);
+}
+
+static int load_string_tables(char *p, char *end, int copy)
+{
+  if (end - p < (long) sizeof(stringtab_magic) ||
+      memcmp(p, stringtab_magic, sizeof(stringtab_magic)) != 0)
+    return 0;
+  p += sizeof(stringtab_magic);
+  if ((p = idtable.load_binary(p, end, copy)) == NULL)
+    return 0;
+  if ((p = inttable.load_binary(p, end, copy)) == NULL)
+    return 0;
+  if ((p = stringtable.load_binary(p, end, copy)) == NULL)
+    return 0;
+  return 1;
+}
+
+//
+// If f is a regular file, map_string_tables maps it and loads the tables
+// from the rest of it, in place.  The mapping is private and is never
+// unmapped, since the tables use it.  It returns -1 if f cannot be
+// mapped, so that the caller reads it instead.
+//
+static int map_string_tables(FILE *f)
+{
+  struct stat st;
+  long pos = ftell(f);
+  if (fstat(fileno(f), &st) < 0 || !S_ISREG(st.st_mode) || pos < 0 ||
+      pos >= st.st_size)
+    return -1;
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+  if (base == MAP_FAILED)
+    return -1;
+  fseek(f, 0, SEEK_END);
+  return load_string_tables((char *) base + pos, (char *) base + st.st_size,
+			    0);
+}
+
+//
+// read_string_tables loads the tables from the rest of f: mapped, if it
+// is a regular file, and otherwise (a pipe) read into one buffer, from
+// which the tables copy their strings.
+//
+int read_string_tables(FILE *f)
+{
+  int mapped = map_string_tables(f);
+  if (mapped >= 0)
+    return mapped;
+
+  int size = 0, cap = 65536;
+  char *buf = new char[cap];
+  int n;
+  while ((n = fread(buf + size, 1, cap - size, f)) > 0) {
+    size += n;
+    if (size == cap) {
+      char *bigger = new char[2 * cap];
+      memcpy(bigger, buf, size);
+      delete [] buf;
+      buf = bigger;
+      cap *= 2;
+    }
+  }
+  int ok = load_string_tables(buf, buf + size, 1);
+  delete [] buf;
+  return ok;
+}
@@ -14,13 +14,23 @@
 //      fatal_error            print an error message and exit
 //      print_escaped_string   print a string showing escape characters
 //      print_cool_token       print a cool token and its semantic value
+//      print_parse_error      print a parse error and the token at fault
 //      dump_cool_token        dump a readable token representation
+//      dump_binary_token      dump a token in the binary stream format
+//      next_binary_token      read a token from a binary stream
+//      map_source_file        map a source file for the scanner to read
+//      unmap_source_file      release a mapped source file
 //      strdup                 duplicate a string (missing from some libraries)
 //
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "cool-io.h"     // for cerr, <<, manipulators
 #include <ctype.h>       // for isprint
+#include <string.h>      // for memcmp
+#include <fcntl.h>       // for open
+#include <unistd.h>      // for close, getpagesize
+#include <sys/mman.h>    // for mmap
+#include <sys/stat.h>    // for fstat
 #include "cool-parse.h"  // defines tokens
 #include "stringtab.h"   // Symbol <-> String conversions
 #include "utilities.h"
@@ -123,44 +133,59 @@ char *cool_token_to_string(int tok)
   }
 }
 
-void print_cool_token(int tok)
+void print_cool_token(ostream& out, int tok, YYSTYPE *lval)
 {
-
-  cerr << cool_token_to_string(tok);
+  out << cool_token_to_string(tok);
 
   switch (tok) {
   case (STR_CONST):
-    cerr << " = ";
-    cerr << " \"";
-    print_escaped_string(cerr, cool_yylval.symbol->get_string());
-    cerr << "\"";
+    out << " = ";
+    out << " \"";
+    print_escaped_string(out, lval->symbol->get_string());
+    out << "\"";
 #ifdef CHECK_TABLES
-    stringtable.lookup_string(cool_yylval.symbol->get_string());
+    stringtable.lookup_string(lval->symbol->get_string());
 #endif
     break;
   case (INT_CONST):
-    cerr << " = " << cool_yylval.symbol;
+    out << " = " << lval->symbol;
 #ifdef CHECK_TABLES
-    inttable.lookup_string(cool_yylval.symbol->get_string());
+    inttable.lookup_string(lval->symbol->get_string());
 #endif
     break;
   case (BOOL_CONST):
-    cerr << (cool_yylval.boolean ? " = true" : " = false");
+    out << (lval->boolean ? " = true" : " = false");
     break;
   case (TYPEID):
   case (OBJECTID):
-    cerr << " = " << cool_yylval.symbol;
+    out << " = " << lval->symbol;
 #ifdef CHECK_TABLES
-    idtable.lookup_string(cool_yylval.symbol->get_string());
+    idtable.lookup_string(lval->symbol->get_string());
 #endif
     break;
   case (ERROR): 
-    cerr << " = ";
-    print_escaped_string(cerr, cool_yylval.error_msg);
+    out << " = ";
+    print_escaped_string(out, lval->error_msg);
     break;
   }
 }
 
+void print_cool_token(int tok)
+{
+  print_cool_token(cerr, tok, &cool_yylval);
+}
+
+// print a parse error the way the parser always has:
+//     "file", line n: msg at or near token
+void print_parse_error(ostream& out, char *filename, int lineno, char *msg,
+		       int tok, YYSTYPE *lval)
+{
+  out << "\"" << filename << "\", line " << lineno << ": "
+      << msg << " at or near ";
+  print_cool_token(out, tok, lval);
+  out << endl;
+}
+
 // dump the token in format readable by the sceond phase token lexer
 void dump_cool_token(ostream& out, int lineno, int token, YYSTYPE yylval)
 {
@@ -210,6 +235,226 @@ void dump_cool_token(ostream& out, int lineno, int token, YYSTYPE yylval)
     out << endl;
 }
 
+//
+// Binary token streams
+//
+// With the -b flag the lexer writes, and the parser reads, a binary token
+// stream instead of dump_cool_token's text.  The stream is
+//
+//     the magic string "COOLTOK1"
+//     one token_record per token, in the byte order of the machine
+//     an end record
+//     the string tables, as written by write_string_tables
+//
+// A record holds the token, its line number and its value: the index of
+// its symbol in the matching table for STR_CONST, INT_CONST, TYPEID and
+// OBJECTID, 0 or 1 for BOOL_CONST, and the index of the message in the
+// string table for ERROR.  A record with token NAME_TOKEN starts a new
+// input file; its value is the index of the file name in the string table.
+// Since the lexer and the parser build their tables in the same order,
+// the parser gets exactly the lexer's symbols, with the same indices,
+// and never scans a symbol's characters.
+//
+// The tables come last because the lexer only knows them in full at the
+// end, so the reader reads all the records before returning the first
+// token.
+//
+
+extern int curr_lineno;
+extern char *curr_filename;
+
+static const char token_magic[8] = { 'C','O','O','L','T','O','K','1' };
+
+#define NAME_TOKEN (-1)
+#define END_TOKEN  (-2)
+
+struct token_record {
+  int token;
+  int lineno;
+  int value;
+};
+
+static void write_token_record(FILE *out, int token, int lineno, int value)
+{
+  token_record r;
+  r.token = token;
+  r.lineno = lineno;
+  r.value = value;
+  fwrite(&r, sizeof(r), 1, out);
+}
+
+void begin_binary_tokens(FILE *out)
+{
+  fwrite(token_magic, 1, sizeof(token_magic), out);
+}
+
+void name_binary_tokens(FILE *out, char *filename)
+{
+  write_token_record(out, NAME_TOKEN, 0,
+		     stringtable.add_string(filename)->get_index());
+}
+
+// Like dump_cool_token, this takes the token's value from cool_yylval.
+void dump_binary_token(FILE *out, int lineno, int token)
+{
+  int value = 0;
+
+  switch (token) {
+  case (STR_CONST):
+  case (INT_CONST):
+  case (TYPEID):
+  case (OBJECTID):
+    value = cool_yylval.symbol->get_index();
+    break;
+  case (BOOL_CONST):
+    value = cool_yylval.boolean;
+    break;
+  case (ERROR):
+    value = stringtable.add_string(cool_yylval.error_msg)->get_index();
+    break;
+  }
+  write_token_record(out, token, lineno, value);
+}
+
+void end_binary_tokens(FILE *out)
+{
+  write_token_record(out, END_TOKEN, 0, 0);
+  write_string_tables(out);
+  fflush(out);
+}
+
+static token_record *token_records;   // the records of the stream
+static int token_count;               // how many there are
+static int token_next;                // the next one to return
+
+static void read_binary_tokens(FILE *in)
+{
+  char magic[sizeof(token_magic)];
+  int cap = 4096;
+
+  if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+      memcmp(magic, token_magic, sizeof(magic)) != 0)
+    fatal_error("Input is not a binary token stream\n");
+
+  token_records = new token_record[cap];
+  for (;;) {
+    if (token_count == cap) {
+      token_record *bigger = new token_record[2 * cap];
+      memcpy(bigger, token_records, token_count * sizeof(token_record));
+      delete [] token_records;
+      token_records = bigger;
+      cap *= 2;
+    }
+    if (fread(&token_records[token_count], sizeof(token_record), 1, in) != 1)
+      fatal_error("Truncated binary token stream\n");
+    if (token_records[token_count].token == END_TOKEN)
+      break;
+    token_count++;
+  }
+  if (!read_string_tables(in))
+    fatal_error("Bad string tables in binary token stream\n");
+}
+
+//
+// next_binary_token returns the next token of the binary stream in,
+// setting cool_yylval, curr_lineno and curr_filename as the text token
+// scanner does, or 0 at the end of the stream.
+//
+int next_binary_token(FILE *in)
+{
+  if (token_records == NULL)
+    read_binary_tokens(in);
+
+  while (token_next < token_count) {
+    token_record *r = &token_records[token_next++];
+    switch (r->token) {
+    case (NAME_TOKEN):
+      curr_filename = stringtable.lookup(r->value)->get_string();
+      continue;
+    case (STR_CONST):
+      cool_yylval.symbol = stringtable.lookup(r->value);
+      break;
+    case (INT_CONST):
+      cool_yylval.symbol = inttable.lookup(r->value);
+      break;
+    case (TYPEID):
+    case (OBJECTID):
+      cool_yylval.symbol = idtable.lookup(r->value);
+      break;
+    case (BOOL_CONST):
+      cool_yylval.boolean = r->value;
+      break;
+    case (ERROR):
+      cool_yylval.error_msg = stringtable.lookup(r->value)->get_string();
+      break;
+    }
+    curr_lineno = r->lineno;
+    return r->token;
+  }
+  return 0;
+}
+
+//
+// Mapped source files
+//
+// With the -m flag the lexer scans each source file where it lies in
+// memory (with yy_scan_buffer; see cool.flex) instead of reading it into
+// flex's buffer through YY_INPUT.  flex needs two NULs after the text,
+// so map_source_file reserves zeroed pages for the text and the two
+// NULs, and maps the file over the front of them; the pages past the
+// end of the file stay zero.  The mapping is private and writable,
+// because flex briefly stores a NUL after each token.  That copies
+// every page, so the file is mapped with MAP_POPULATE where there is
+// one, to take the page faults in one go rather than one at a time.
+//
+// map_source_file returns the text and sets *len to its size plus the
+// two NULs, or returns NULL if the file cannot be mapped.
+//
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0
+#endif
+
+static size_t mapped_size(size_t len)
+{
+  size_t page = getpagesize();
+  return (len + page - 1) / page * page;
+}
+
+char *map_source_file(char *filename, size_t *len)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = st.st_size;
+  void *base = mmap(NULL, mapped_size(size + 2), PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+  if (size > 0 &&
+      mmap(base, size, PROT_READ | PROT_WRITE,
+	   MAP_PRIVATE | MAP_FIXED | MAP_POPULATE, fd, 0) == MAP_FAILED) {
+    munmap(base, mapped_size(size + 2));
+    close(fd);
+    return NULL;
+  }
+  close(fd);
+  *len = size + 2;
+  return (char *) base;
+}
+
+void unmap_source_file(char *text, size_t len)
+{
+  munmap(text, mapped_size(len));
+}
+
 //
 // Decstations don't have strdup in the library.
 //